@@ -0,0 +1,94 @@
+// Measures how a single detour scales when it is entered from several threads at once.
+// Build with 'make bench' and run './hookscaling [calls per thread]'.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <GoldMeta/Gold/IHookContext.hpp>
+#include <GoldMeta/Gold/IModuleFunction.hpp>
+
+#include "GoldHook/StaticFuntion.hpp"
+#include "OS/CodeArena.hpp"
+#include "OS/OS.hpp"
+
+using namespace gm;
+
+namespace {
+    std::atomic<uint64> gListenerCalls(0);
+
+    __attribute__((noinline)) int Add(int a, int b) {
+        // Prevent the compiler from folding the calls
+        asm volatile("");
+        return a + b;
+    }
+
+    int STDCALL OnAdd(IHookContext* context, int, int) {
+        gListenerCalls.fetch_add(1, std::memory_order_relaxed);
+        context->SetResult(Result::Ignored);
+        return 0;
+    }
+
+    double Run(size_t threadCount, size_t calls) {
+        std::atomic<bool> start(false);
+        std::vector<std::thread> threads;
+
+        for(size_t i = 0; i < threadCount; i++) {
+            threads.emplace_back([&start, calls]() {
+                // The function pointer is volatile so every call goes through the detour
+                int(*volatile add)(int, int) = &Add;
+
+                while(!start.load()) {
+                    std::this_thread::yield();
+                }
+
+                for(size_t n = 0; n < calls; n++) {
+                    add(static_cast<int>(n), 1);
+                }
+            });
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        start.store(true);
+
+        for(std::thread& thread : threads) {
+            thread.join();
+        }
+
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t calls = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    StaticFunction function("Add", ConventionInfo(CallingConvention::CDecl, DataType::FromType<int>(), { DataType::FromType<int>(), DataType::FromType<int>() }), reinterpret_cast<void*>(&Add));
+    function.GetModule(PluginId(1))->SetListener(reinterpret_cast<void*>(&OnAdd), nullptr, Tense::Pre);
+
+    // Warm up the per-thread context pools and the generated handlers
+    Run(1, 1000);
+
+    std::cout << "threads\tcalls/s\t\tns/call (per thread)\n";
+
+    for(size_t threadCount : { 1, 2, 4, 8 }) {
+        gListenerCalls = 0;
+        double seconds = Run(threadCount, calls);
+
+        if(gListenerCalls != threadCount * calls) {
+            std::cerr << "[ERROR] Expected " << threadCount * calls << " listener calls, got " << gListenerCalls << std::endl;
+            return 1;
+        }
+
+        std::cout << threadCount << '\t'
+            << static_cast<uint64>((threadCount * calls) / seconds) << "\t"
+            << (seconds * 1e9) / calls << '\n';
+    }
+
+    CodeArena::Usage usage = CodeArena::GetGlobal().GetUsage();
+    std::cout << "code arena: " << usage.used << " of " << usage.reserved << " bytes used in " << usage.regions << " region(s)\n";
+
+    return 0;
+}
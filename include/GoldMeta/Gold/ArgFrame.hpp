@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <tuple>
+
+namespace gm {
+    /// <summary>
+    /// A view of a hooked function's arguments, laid out as they were passed on the stack (each one is
+    /// aligned to a double word). Frame listeners receive it instead of a copy of every argument.
+    /// </summary>
+    class ArgFrame {
+    public:
+        /// <summary>
+        /// Gets the argument at an offset from the first argument
+        /// </summary>
+        template <typename T>
+        const T& At(size_t offset) const {
+            return *reinterpret_cast<const T*>(reinterpret_cast<const char*>(this) + offset);
+        }
+
+    private:
+        // Frames are only ever referred to by pointer
+        ArgFrame();
+        ArgFrame(const ArgFrame&);
+    };
+
+    /// <summary>
+    /// Describes the layout of a frame with the specified parameters
+    /// </summary>
+    template <typename... Args>
+    struct ArgFrameOf;
+
+    template <>
+    struct ArgFrameOf<> {
+        template <size_t I>
+        struct Offset { static const size_t value = 0; };
+    };
+
+    template <typename T, typename... Rest>
+    struct ArgFrameOf<T, Rest...> {
+        /// <summary>
+        /// The type of an argument
+        /// </summary>
+        template <size_t I>
+        using Type = typename std::tuple_element<I, std::tuple<T, Rest...>>::type;
+
+        /// <summary>
+        /// The offset of an argument from the first one (arguments are pushed as double words)
+        /// </summary>
+        template <size_t I, bool First = (I == 0)>
+        struct Offset { static const size_t value = ((sizeof(T) + 3) & ~size_t(3)) + ArgFrameOf<Rest...>::template Offset<I - 1>::value; };
+
+        template <size_t I>
+        struct Offset<I, true> { static const size_t value = 0; };
+
+        /// <summary>
+        /// Gets an argument from a frame (e.g 'ArgFrameOf<int, float>::Get<1>(frame)')
+        /// </summary>
+        template <size_t I>
+        static const Type<I>& Get(const ArgFrame* frame) {
+            return frame->At<Type<I>>(Offset<I>::value);
+        }
+    };
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <GoldMeta/Gold/ArgFrame.hpp>
+#include <GoldMeta/Gold/Signature.hpp>
+
+namespace gm {
+    /// <summary>
+    /// A snapshot of a completed call, delivered to asynchronous listeners ('Tense::Async'). It is
+    /// only valid during the listener call, since the copies are reused for the next batch.
+    /// </summary>
+    struct AsyncCall {
+        const ArgFrame* arguments; /* A copy of the arguments as the original function received them */
+        const void* returnValue;   /* A copy of the value returned to the caller (null for void functions) */
+        void* callerAddress;
+        void* object;              /* The object instance (only valid for methods) */
+    };
+
+    /// <summary>
+    /// The listener type for 'Tense::Async', which is called by a worker thread with a batch of calls
+    /// </summary>
+    typedef void(GM_STDCALL *AsyncListener)(void* context, const AsyncCall* calls, unsigned int count);
+}
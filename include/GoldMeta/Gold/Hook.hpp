@@ -0,0 +1,291 @@
+#pragma once
+
+#include <GoldMeta/Gold/ArgFrame.hpp>
+#include <GoldMeta/Gold/AsyncCall.hpp>
+#include <GoldMeta/Gold/IGoldHook.hpp>
+#include <GoldMeta/Gold/IHookContext.hpp>
+#include <GoldMeta/Gold/IModuleFunction.hpp>
+#include <GoldMeta/Gold/Signature.hpp>
+#include <cstdarg>
+
+namespace gm {
+    /// <summary>
+    /// Describes the typed function pointers of a hook
+    /// </summary>
+    template <Convention C, typename R, typename... Args>
+    struct HookTraits;
+
+    template <typename R, typename... Args>
+    struct HookTraits<Convention::CDecl, R, Args...> {
+        typedef R(GM_STDCALL *Listener)(IHookContext*, Args...);
+        typedef ArgFrameOf<Args...> Frame;
+        typedef R(GM_CDECL *Original)(Args...);
+
+        static R Call(void* address, Args... args) { return reinterpret_cast<Original>(address)(args...); }
+    };
+
+    template <typename R, typename... Args>
+    struct HookTraits<Convention::Stdcall, R, Args...> {
+        typedef R(GM_STDCALL *Listener)(IHookContext*, Args...);
+        typedef ArgFrameOf<Args...> Frame;
+        typedef R(GM_STDCALL *Original)(Args...);
+
+        static R Call(void* address, Args... args) { return reinterpret_cast<Original>(address)(args...); }
+    };
+
+    template <typename R, typename... Args>
+    struct HookTraits<Convention::Fastcall, R, Args...> {
+        typedef R(GM_STDCALL *Listener)(IHookContext*, Args...);
+        typedef ArgFrameOf<Args...> Frame;
+        typedef R(GM_FASTCALL *Original)(Args...);
+
+        static R Call(void* address, Args... args) { return reinterpret_cast<Original>(address)(args...); }
+    };
+
+    template <typename R, typename Object, typename... Args>
+    struct HookTraits<Convention::Thiscall, R, Object, Args...> {
+        // The object instance is retrieved with 'IHookContext::GetContext' by listeners
+        typedef R(GM_STDCALL *Listener)(IHookContext*, Args...);
+        typedef ArgFrameOf<Args...> Frame;
+#ifdef _MSC_VER
+        // MSVC does not allow 'thiscall' for non-member functions, but a 'fastcall' with
+        // an unused second parameter passes the object in ECX and the rest on the stack.
+        typedef R(GM_FASTCALL *Original)(Object, void*, Args...);
+
+        static R Call(void* address, Object object, Args... args) { return reinterpret_cast<Original>(address)(object, nullptr, args...); }
+#else
+        typedef R(GM_THISCALL *Original)(Object, Args...);
+
+        static R Call(void* address, Object object, Args... args) { return reinterpret_cast<Original>(address)(object, args...); }
+#endif
+    };
+
+    /// <summary>
+    /// The untyped part of a hook, which owns the listener
+    /// </summary>
+    class HookBase {
+    public:
+        /// <summary>
+        /// Destructor for the hook (the listener is released)
+        /// </summary>
+        ~HookBase() {
+            this->Release();
+        }
+
+        /// <summary>
+        /// Gets the untyped module function (null if not attached)
+        /// </summary>
+        IModuleFunction* GetModule() const {
+            return mModule;
+        }
+
+        /// <summary>
+        /// Releases the listener
+        /// </summary>
+        void Release() {
+            if(mModule != nullptr) {
+                mModule->Release();
+                mModule = nullptr;
+            }
+        }
+
+    protected:
+        /// <summary>
+        /// Constructs an unattached hook
+        /// </summary>
+        HookBase() : mModule(nullptr) { }
+
+        /// <summary>
+        /// Attaches the hook to a function, returning whether it succeeded or not
+        /// </summary>
+        bool Attach(IGoldHook* goldHook, PluginId id, const char* name, void* address, const Signature& signature) {
+            this->Release();
+
+            mModule = goldHook->GetFunction(id, name, address, signature);
+            return mModule != nullptr;
+        }
+
+        // Protected members
+        IModuleFunction* mModule;
+
+    private:
+        // Hooks own their listener, so they cannot be copied
+        HookBase(const HookBase&);
+        HookBase& operator=(const HookBase&);
+    };
+
+    /// <summary>
+    /// A typed hook of a function (e.g 'Hook<int(const char*)>'), with the signature derived at compile time
+    /// </summary>
+    template <typename Function, Convention C = Convention::CDecl>
+    class Hook;
+
+    template <typename R, typename... Args, Convention C>
+    class Hook<R(Args...), C> : public HookBase {
+    public:
+        /// <summary>
+        /// The typed function pointers of this hook
+        /// </summary>
+        typedef HookTraits<C, R, Args...> Traits;
+        typedef typename Traits::Listener Listener;
+        typedef typename Traits::Frame Frame;
+
+        /// <summary>
+        /// The frame listener type, which reads the arguments with 'Frame::Get<Index>(frame)'
+        /// </summary>
+        typedef R(GM_STDCALL *FrameListener)(IHookContext*, const ArgFrame*);
+
+        /// <summary>
+        /// Constructs an unattached hook
+        /// </summary>
+        Hook() { }
+
+        /// <summary>
+        /// Constructs a hook and attaches it to a function
+        /// </summary>
+        Hook(IGoldHook* goldHook, PluginId id, const char* name, void* address) {
+            this->Attach(goldHook, id, name, address);
+        }
+
+        /// <summary>
+        /// Attaches the hook to a function, returning whether it succeeded or not
+        /// </summary>
+        bool Attach(IGoldHook* goldHook, PluginId id, const char* name, void* address) {
+            return HookBase::Attach(goldHook, id, name, address, SignatureOf<C, R, Args...>::Describe());
+        }
+
+        /// <summary>
+        /// Attaches the hook to a function that passes parameters or its return value in custom locations
+        /// ('locations' has one entry per parameter, or is null). 'CallOriginal' cannot call such functions,
+        /// so 'IModuleFunction::Call' must be used instead.
+        /// </summary>
+        bool AttachRegisters(IGoldHook* goldHook, PluginId id, const char* name, void* address, const Location* locations, Location returnLocation = Location::Default) {
+            Signature signature = SignatureOf<C, R, Args...>::Describe();
+            signature.locations = locations;
+            signature.returnLocation = returnLocation;
+
+            return HookBase::Attach(goldHook, id, name, address, signature);
+        }
+
+        /// <summary>
+        /// Attaches the hook to a slot within an object's virtual table, returning whether it succeeded or not
+        /// </summary>
+        bool AttachVirtual(IGoldHook* goldHook, PluginId id, const char* name, void* object, unsigned int index) {
+            this->Release();
+
+            mModule = goldHook->GetVirtualFunction(id, name, object, index, SignatureOf<C, R, Args...>::Describe());
+            return mModule != nullptr;
+        }
+
+        /// <summary>
+        /// Attaches the hook to a slot within the virtual table of a single object, returning whether it succeeded or not
+        /// </summary>
+        bool AttachInstance(IGoldHook* goldHook, PluginId id, const char* name, void* object, unsigned int index, unsigned int slotCount) {
+            this->Release();
+
+            mModule = goldHook->GetInstanceFunction(id, name, object, index, slotCount, SignatureOf<C, R, Args...>::Describe());
+            return mModule != nullptr;
+        }
+
+        /// <summary>
+        /// Attaches the hook to a symbol imported by a module, returning whether it succeeded or not
+        /// </summary>
+        bool AttachImport(IGoldHook* goldHook, PluginId id, const char* module, const char* symbol) {
+            this->Release();
+
+            mModule = goldHook->GetImportFunction(id, module, symbol, SignatureOf<C, R, Args...>::Describe());
+            return mModule != nullptr;
+        }
+
+        /// <summary>
+        /// Sets the listener (higher priorities are called first)
+        /// </summary>
+        void SetListener(Listener listener, int tense, int priority = 0) {
+            mModule->SetListener(reinterpret_cast<void*>(listener), nullptr, tense, priority);
+        }
+
+        /// <summary>
+        /// Sets a listener that receives a view of the arguments instead of a copy of each one, which is
+        /// cheaper for functions with many (or large) arguments (higher priorities are called first)
+        /// </summary>
+        void SetFrameListener(FrameListener listener, int tense, int priority = 0) {
+            mModule->SetFrameListener(reinterpret_cast<void*>(listener), nullptr, tense, priority);
+        }
+
+        /// <summary>
+        /// Sets a listener that observes completed calls in batches on a worker thread (the arguments
+        /// are read with 'Frame::Get<Index>(call.arguments)', and the result cannot be changed)
+        /// </summary>
+        void SetAsyncListener(AsyncListener listener, void* context = nullptr, int priority = 0) {
+            mModule->SetListener(reinterpret_cast<void*>(listener), context, Tense::Async, priority);
+        }
+
+        /// <summary>
+        /// Calls the original function directly, without any listeners or argument marshaling
+        /// </summary>
+        R CallOriginal(Args... args) const {
+            return Traits::Call(mModule->GetCallableAddress(), args...);
+        }
+    };
+
+    template <typename R, typename... Args, Convention C>
+    class Hook<R(Args..., ...), C> : public HookBase {
+    public:
+        static_assert(C == Convention::CDecl, "Variadic functions must use the 'cdecl' convention");
+
+        /// <summary>
+        /// The listener type, which receives the variadic arguments as a 'va_list'
+        /// </summary>
+        typedef R(GM_STDCALL *Listener)(IHookContext*, Args..., va_list);
+
+        /// <summary>
+        /// Constructs an unattached hook
+        /// </summary>
+        Hook() { }
+
+        /// <summary>
+        /// Constructs a hook and attaches it to a function
+        /// </summary>
+        Hook(IGoldHook* goldHook, PluginId id, const char* name, void* address) {
+            this->Attach(goldHook, id, name, address);
+        }
+
+        /// <summary>
+        /// Attaches the hook to a function, returning whether it succeeded or not
+        /// </summary>
+        bool Attach(IGoldHook* goldHook, PluginId id, const char* name, void* address) {
+            Signature signature = SignatureOf<C, R, Args...>::Describe();
+            signature.isVariadic = true;
+
+            return HookBase::Attach(goldHook, id, name, address, signature);
+        }
+
+        /// <summary>
+        /// Attaches the hook to a symbol imported by a module, returning whether it succeeded or not
+        /// </summary>
+        bool AttachImport(IGoldHook* goldHook, PluginId id, const char* module, const char* symbol) {
+            Signature signature = SignatureOf<C, R, Args...>::Describe();
+            signature.isVariadic = true;
+
+            this->Release();
+
+            mModule = goldHook->GetImportFunction(id, module, symbol, signature);
+            return mModule != nullptr;
+        }
+
+        /// <summary>
+        /// Sets the listener (higher priorities are called first)
+        /// </summary>
+        void SetListener(Listener listener, int tense, int priority = 0) {
+            mModule->SetListener(reinterpret_cast<void*>(listener), nullptr, tense, priority);
+        }
+
+        /// <summary>
+        /// Calls the original function directly, forwarding any variadic arguments as is
+        /// </summary>
+        template <typename... Extra>
+        R CallOriginal(Args... args, Extra... extra) const {
+            return reinterpret_cast<R(GM_CDECL *)(Args..., ...)>(mModule->GetCallableAddress())(args..., extra...);
+        }
+    };
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <GoldMeta/Gold/GoldDefs.hpp>
+#include <GoldMeta/Gold/Signature.hpp>
+#include <GoldMeta/Gold/IMidHook.hpp>
 
 namespace gm {
     // Forward declarations
@@ -32,5 +34,32 @@ namespace gm {
         /// Gets a function handler for a library API function
         /// </summary>
         //virtual IModuleFunction* GetLibraryFunction(PluginId id, LibraryAPI function) = 0;
+
+        /// <summary>
+        /// Gets a function handler for a custom function with a known signature (see 'Hook')
+        /// </summary>
+        virtual IModuleFunction* GetFunction(PluginId id, const char* name, void* addr, const Signature& signature) = 0;
+
+        /// <summary>
+        /// Gets a function handler for a virtual function, by replacing a slot of the object's virtual table
+        /// </summary>
+        virtual IModuleFunction* GetVirtualFunction(PluginId id, const char* name, void* object, unsigned int index, const Signature& signature) = 0;
+
+        /// <summary>
+        /// Gets a function handler for a virtual function of a single object, by giving it a copy of its
+        /// virtual table with 'slotCount' slots (the handler must be released before the object is destroyed)
+        /// </summary>
+        virtual IModuleFunction* GetInstanceFunction(PluginId id, const char* name, void* object, unsigned int index, unsigned int slotCount, const Signature& signature) = 0;
+
+        /// <summary>
+        /// Gets a function handler for a symbol imported by a module (e.g 'malloc' in 'mp.dll'), by replacing
+        /// its import table slot; only calls made from that module are hooked (an empty name is the executable)
+        /// </summary>
+        virtual IModuleFunction* GetImportFunction(PluginId id, const char* module, const char* symbol, const Signature& signature) = 0;
+
+        /// <summary>
+        /// Gets a hook for an instruction within a function, which gives its listeners the registers at that point
+        /// </summary>
+        virtual IMidHook* GetMidHook(PluginId id, void* address) = 0;
     };
 }
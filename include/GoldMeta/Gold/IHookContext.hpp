@@ -14,7 +14,7 @@ namespace gm {
         virtual void* GetContext() = 0;
 
         /// <summary>
-        /// Sets the value of a specific parameter (must return at least Result::Handled)
+        /// Sets the value of a specific parameter for the following modules and the original function (only valid in pre)
         /// </summary>
         virtual void SetParameter(unsigned int index, const void* value) = 0;
 
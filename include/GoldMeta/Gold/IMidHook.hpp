@@ -0,0 +1,51 @@
+#pragma once
+
+#include <GoldMeta/Shared.hpp>
+#include <GoldMeta/Gold/Signature.hpp>
+#include <cstdint>
+
+namespace gm {
+    /// <summary>
+    /// The registers at a mid-function hook, in the order 'pushad' stores them (changes are applied,
+    /// except to 'esp', which holds the stack pointer as it was before the hooked instruction)
+    /// </summary>
+    struct Registers {
+        uint32_t edi;
+        uint32_t esi;
+        uint32_t ebp;
+        uint32_t esp;
+        uint32_t ebx;
+        uint32_t edx;
+        uint32_t ecx;
+        uint32_t eax;
+        uint32_t eflags;
+    };
+
+    class IMidHook {
+    public:
+        /// <summary>
+        /// The listener type, which is called before the hooked instruction executes
+        /// </summary>
+        typedef void(GM_CDECL *Listener)(Registers* registers, void* context);
+
+        /// <summary>
+        /// Sets the current listener for this hook (higher priorities are called first)
+        /// </summary>
+        virtual void SetListener(Listener listener, void* context, int priority = 0) = 0;
+
+        /// <summary>
+        /// Disables (pauses) the current listener
+        /// </summary>
+        virtual void DisableListener() = 0;
+
+        /// <summary>
+        /// Enables (resumes) the current listener
+        /// </summary>
+        virtual void EnableListener() = 0;
+
+        /// <summary>
+        /// Releases the hook
+        /// </summary>
+        virtual void Release() = 0;
+    };
+}
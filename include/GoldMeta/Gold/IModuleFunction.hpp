@@ -11,9 +11,67 @@ namespace gm {
         enum Type {
             Pre = (1 << 0),
             Post = (1 << 1),
+            Async = (1 << 2), /* After the call, on a worker thread (the listener is an 'AsyncListener') */
         };
     }
 
+    // We use a namespace for the same reason as 'Tense'
+    namespace Predicate {
+        /// <summary>
+        /// Describes how an argument is tested before a listener is called
+        /// </summary>
+        enum Type {
+            Equal,       /* The argument equals the first value */
+            NotEqual,    /* The argument does not equal the first value */
+            AnyBits,     /* The argument has any of the bits in the first value set */
+            NoBits,      /* The argument has none of the bits in the first value set */
+            Range,       /* The argument is within the first and second value (inclusive, unsigned) */
+            SignedRange, /* The argument is within the first and second value (inclusive, signed) */
+            OneOf,       /* The argument equals one of the values */
+        };
+    }
+
+    // We use a namespace for the same reason as 'Tense'
+    namespace Cache {
+        /// <summary>
+        /// Describes how long a memoized result is returned for the same arguments
+        /// </summary>
+        enum Scope {
+            Disabled, /* The function is always called */
+            Manual,   /* Until 'IModuleFunction::InvalidateCache' is called */
+            Frame,    /* Until the next server frame */
+            Map,      /* Until the next map is activated */
+        };
+    }
+
+    /// <summary>
+    /// A test of an integer or pointer argument, which must pass for a listener to be called
+    /// </summary>
+    struct ArgPredicate {
+        static const unsigned int MaxValues = 4;
+
+        unsigned int parameter;       /* The index of the parameter (the object instance is not a parameter) */
+        Predicate::Type type;
+        unsigned int values[MaxValues];
+        unsigned int count;           /* The number of values used by 'OneOf' */
+
+        /// <summary>
+        /// Creates a predicate that compares the argument with a value or mask
+        /// </summary>
+        static ArgPredicate Make(unsigned int parameter, Predicate::Type type, unsigned int value) {
+            ArgPredicate predicate = { parameter, type, { value }, 1 };
+            return predicate;
+        }
+
+        /// <summary>
+        /// Creates a predicate that checks whether the argument is within an inclusive range
+        /// </summary>
+        static ArgPredicate MakeRange(unsigned int parameter, unsigned int low, unsigned int high, bool isSigned = false) {
+            ArgPredicate predicate = { parameter, isSigned ? Predicate::SignedRange : Predicate::Range, { low, high }, 2 };
+            return predicate;
+        }
+    };
+
     class IModuleFunction {
     public:
         /// <summary>
@@ -22,9 +80,9 @@ namespace gm {
         virtual void* GetCallableAddress() = 0;
 
         /// <summary>
-        /// Sets the current listener for this function module
+        /// Sets the current listener for this function module (higher priorities are called first)
         /// </summary>
-        virtual void SetListener(void* callback, void* context, int tense) = 0;
+        virtual void SetListener(void* callback, void* context, int tense, int priority = 0) = 0;
 
         /// <summary>
         /// Sets the listener tense (can be both pre and post simultaneously)
@@ -65,5 +123,68 @@ namespace gm {
         /// Gets the module function context
         /// </summary>
         virtual void* GetContext() = 0;
+
+        /// <summary>
+        /// Sets a listener that receives '(IHookContext*, const ArgFrame*)' instead of a copy of each argument
+        /// </summary>
+        virtual void SetFrameListener(void* callback, void* context, int tense, int priority = 0) = 0;
+
+        /// <summary>
+        /// Gets whether the listener receives an argument frame
+        /// </summary>
+        virtual bool IsFrameListener() = 0;
+
+        /// <summary>
+        /// Restricts the listener to calls with a return address within [begin, end); it is
+        /// called for all callers until a range is added (ranges are checked before the call)
+        /// </summary>
+        virtual void AddCallerRange(const void* begin, const void* end) = 0;
+
+        /// <summary>
+        /// Restricts the listener to calls from a loaded library (e.g 'cs.so'), returning whether it was found
+        /// </summary>
+        virtual bool AddCallerModule(const char* module) = 0;
+
+        /// <summary>
+        /// Removes all caller ranges, so the listener is called for all callers again
+        /// </summary>
+        virtual void ClearCallerRanges() = 0;
+
+        /// <summary>
+        /// Adds a predicate that all calls must pass for the listener to be called (they are all required),
+        /// returning false if the parameter cannot be tested
+        /// </summary>
+        virtual bool AddPredicate(const ArgPredicate& predicate) = 0;
+
+        /// <summary>
+        /// Removes all predicates
+        /// </summary>
+        virtual void ClearPredicates() = 0;
+
+        /// <summary>
+        /// Memoizes the function's results (for all listeners), so calls with the same arguments return
+        /// the cached result without calling the listeners or the original function. The arguments are
+        /// compared bitwise, except 'const char*' parameters, which are compared by their contents. This is
+        /// refused (returning false) for functions with any other pointer parameters, since what they point
+        /// at may change between calls. The function must also not be variadic or return void.
+        /// </summary>
+        virtual bool SetCacheScope(Cache::Scope scope) = 0;
+
+        /// <summary>
+        /// Removes all memoized results of the function
+        /// </summary>
+        virtual void InvalidateCache() = 0;
+
+        /// <summary>
+        /// Calls the listener for every Nth call only (one calls it for all), which is meant for listeners that
+        /// merely gather statistics. A listener that is both pre and post is called in post for the same calls.
+        /// </summary>
+        virtual void SetSampleInterval(unsigned int interval) = 0;
+
+        /// <summary>
+        /// Calls the listener for a random subset of the calls (the probability must be within (0, 1], and
+        /// replaces any interval), returning false if the probability is invalid
+        /// </summary>
+        virtual bool SetSampleProbability(float probability) = 0;
     };
 }
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <GoldMeta/Shared.hpp>
+#include <type_traits>
+
+// The calling conventions that typed hooks may use
+#ifdef _MSC_VER
+# define GM_CDECL    __cdecl
+# define GM_STDCALL  __stdcall
+# define GM_FASTCALL __fastcall
+#else
+# define GM_CDECL    __attribute__((cdecl))
+# define GM_STDCALL  __attribute__((stdcall))
+# define GM_FASTCALL __attribute__((fastcall))
+# define GM_THISCALL __attribute__((thiscall))
+#endif
+
+namespace gm {
+    /// <summary>
+    /// Describes the calling convention of a hooked function
+    /// </summary>
+    enum class Convention {
+        Thiscall, /* The first parameter is the object instance */
+        Fastcall,
+        Stdcall,
+        CDecl,
+    };
+
+    /// <summary>
+    /// Describes where a parameter or return value is passed, for functions compiled with 'regparm'
+    /// or custom register assignments (only integers and pointers may be passed in registers)
+    /// </summary>
+    enum class Location {
+        Default, /* As the calling convention specifies */
+        Stack,
+        EAX,
+        ECX,
+        EDX,
+    };
+
+    /// <summary>
+    /// Describes the layout of a parameter or return type
+    /// </summary>
+    struct TypeDescriptor {
+        enum Type {
+            Pointer,
+            Integral,
+            FloatingPoint,
+            Structure,
+            Class,
+            Void,
+            String, /* A 'const char*' to a null-terminated string, which is otherwise passed like a pointer */
+        };
+
+        Type type;
+        unsigned int size;
+        bool isUnsigned;
+    };
+
+    /// <summary>
+    /// Describes the signature of a hooked function
+    /// </summary>
+    struct Signature {
+        Convention convention;
+        TypeDescriptor returnType;
+        const TypeDescriptor* parameters;
+        unsigned int parameterCount;
+        bool isVariadic; /* The parameters are followed by '...' (listeners receive a 'va_list') */
+        const Location* locations; /* The location of each parameter, or null if they are all default */
+        Location returnLocation;
+    };
+
+    /// <summary>
+    /// Describes a type (this is resolved at compile time, so it costs nothing at runtime)
+    /// </summary>
+    template <typename T>
+    inline TypeDescriptor DescribeType() {
+        static_assert(!std::is_pointer<T>::value || sizeof(T) == sizeof(void*), "Pointers must be the size of 'void*'");
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value || std::is_reference<T>::value || std::is_class<T>::value,
+            "The type cannot be used in a hook signature");
+
+        TypeDescriptor result = {};
+        result.size = sizeof(T);
+
+        if(std::is_integral<T>::value || std::is_enum<T>::value) {
+            result.type = TypeDescriptor::Integral;
+            result.isUnsigned = std::is_unsigned<T>::value;
+        } else if(std::is_pointer<T>::value || std::is_reference<T>::value) {
+            // Strings are told apart, since memoized functions compare them by their contents rather than their address
+            result.type = std::is_same<T, const char*>::value ? TypeDescriptor::String : TypeDescriptor::Pointer;
+            result.size = sizeof(void*);
+        } else if(std::is_floating_point<T>::value) {
+            result.type = TypeDescriptor::FloatingPoint;
+        } else /* Class */ {
+            result.type = std::is_pod<T>::value ? TypeDescriptor::Structure : TypeDescriptor::Class;
+        }
+
+        return result;
+    }
+
+    template <>
+    inline TypeDescriptor DescribeType<void>() {
+        TypeDescriptor result = { TypeDescriptor::Void, 0, false };
+        return result;
+    }
+
+    /// <summary>
+    /// Describes the signature of a function type (the object instance of a 'thiscall' is not a parameter)
+    /// </summary>
+    template <Convention C, typename R, typename... Args>
+    struct SignatureOf {
+        static Signature Describe() {
+            // An extra element is added, since zero sized arrays are not allowed
+            static const TypeDescriptor parameters[] = { DescribeType<Args>()..., DescribeType<void>() };
+            Signature result = { C, DescribeType<R>(), parameters, sizeof...(Args), false, nullptr, Location::Default };
+
+            return result;
+        }
+    };
+
+    template <typename R, typename Object, typename... Args>
+    struct SignatureOf<Convention::Thiscall, R, Object, Args...> {
+        static Signature Describe() {
+            static_assert(std::is_pointer<Object>::value, "The first parameter of a 'thiscall' must be the object pointer");
+
+            Signature result = SignatureOf<Convention::CDecl, R, Args...>::Describe();
+            result.convention = Convention::Thiscall;
+
+            return result;
+        }
+    };
+}
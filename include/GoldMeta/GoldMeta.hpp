@@ -6,4 +6,8 @@
 #include <GoldMeta/Gold/IGoldPlugin.hpp>
 #include <GoldMeta/Gold/IModuleFunction.hpp>
 #include <GoldMeta/Gold/IHookContext.hpp>
-#include <GoldMeta/Gold/IGoldHook.hpp>
\ No newline at end of file
+#include <GoldMeta/Gold/ArgFrame.hpp>
+#include <GoldMeta/Gold/AsyncCall.hpp>
+#include <GoldMeta/Gold/IMidHook.hpp>
+#include <GoldMeta/Gold/IGoldHook.hpp>
+#include <GoldMeta/Gold/Hook.hpp>
\ No newline at end of file
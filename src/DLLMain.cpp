@@ -4,6 +4,7 @@
 #endif
 
 #include "MetaMain.hpp"
+#include "GoldHook/AsyncQueue.hpp"
 #include "OS/OS.hpp"
 
 namespace gm {
@@ -27,6 +28,9 @@ namespace gm {
     }
 
     bool DLLExit() {
+        // The asynchronous listeners' worker must be stopped before any code or state it uses is destroyed
+        AsyncQueue::Shutdown();
+
         if(gMetaMain != nullptr) {
             delete gMetaMain;
             gMetaMain = nullptr;
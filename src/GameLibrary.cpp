@@ -5,6 +5,23 @@
 #include "GameLibrary.hpp"
 #include "PathManager.hpp"
 #include "HLSDK.hpp"
+#include "GoldHook/ResultCache.hpp"
+
+namespace /* Anonymous */ {
+    // The game library's own frame and map callbacks, which are wrapped to invalidate memoized results
+    void (*gStartFrame)() = nullptr;
+    void (*gServerActivate)(HL::edict_t*, int, int) = nullptr;
+
+    void StartFrame() {
+        gm::ResultCache::Advance(gm::Cache::Frame);
+        gStartFrame();
+    }
+
+    void ServerActivate(HL::edict_t* edicts, int edictCount, int clientMax) {
+        gm::ResultCache::Advance(gm::Cache::Map);
+        gServerActivate(edicts, edictCount, clientMax);
+    }
+}
 
 namespace gm {
     GameLibrary::GameLibrary(std::shared_ptr<PathManager> pathManager) :
@@ -107,6 +124,17 @@ namespace gm {
         if(result != 0) {
             // Retrieve the game description and store it in our own string
             mGameDescription.assign(libraryFunctions->pfnGetGameDescription());
+
+            // Memoized results may be invalidated by a new frame or map, so the engine calls us first
+            if(libraryFunctions->pfnStartFrame != nullptr && libraryFunctions->pfnStartFrame != &StartFrame) {
+                gStartFrame = libraryFunctions->pfnStartFrame;
+                libraryFunctions->pfnStartFrame = &StartFrame;
+            }
+
+            if(libraryFunctions->pfnServerActivate != nullptr && libraryFunctions->pfnServerActivate != &ServerActivate) {
+                gServerActivate = libraryFunctions->pfnServerActivate;
+                libraryFunctions->pfnServerActivate = &ServerActivate;
+            }
         }
 
         return result;
@@ -8,6 +8,18 @@
 #include "GoldHook.hpp"
 #include "OS/OS.hpp"
 
+namespace /* Anonymous */ {
+    bool DescribeConvention(const char* name, const gm::Signature& signature, gm::ConventionInfo& cInfo) {
+        try {
+            cInfo = gm::ConventionInfo::FromSignature(signature);
+            return true;
+        } catch(const gm::ConventionInfo::Exception& ex) {
+            std::cerr << format("[WARNING] The signature of '%s' is invalid: %s\n") % name % ex.what();
+            return false;
+        }
+    }
+}
+
 namespace gm {
     GoldHook::GoldHook(std::shared_ptr<PathManager> pathManager, std::string /*dbFile*/) :
         mPathManager(pathManager)
@@ -46,7 +58,12 @@ namespace gm {
             mStaticFunctions[name] = std::make_shared<StaticFunction>(name, ConventionInfo(CallingConvention::Thiscall, /*retType*/DataType::FromType<double>(), { DataType::FromType<double>(), retType, retType, DataType::FromType<float>(), DataType::FromType<float>(), DataType::FromType<int>(), DataType::FromType<int>(), DataType::FromType<int>(), DataType::FromType<float>(), DataType::FromType<void*>(), DataType::FromType<bool>(), DataType::FromType<int>() }), add);
         }
 
-        return mStaticFunctions.find(name)->second->GetModule(id);
+        try {
+            return mStaticFunctions.find(name)->second->GetModule(id);
+        } catch(const Function::Exception& ex) {
+            std::cerr << format("[WARNING] Could not hook function '%s': %s\n") % name % ex.what();
+            return nullptr;
+        }
         /*
         IModuleFunction* result = nullptr;
 
@@ -58,6 +75,184 @@ namespace gm {
         return result;*/
     }
 
+    IModuleFunction* GoldHook::GetFunction(PluginId id, const char* name, void* addr, const Signature& signature) {
+        if(name == nullptr || std::strlen(name) == 0 || addr == nullptr) {
+            std::cerr << "[WARNING] A plugin called 'GetFunction' with an empty name or address\n";
+            return nullptr;
+        }
+
+        // The signature was derived by the plugin at compile time, so no type lookups are required
+        ConventionInfo cInfo;
+
+        if(!DescribeConvention(name, signature, cInfo)) {
+            return nullptr;
+        }
+
+        auto it = mStaticFunctions.find(name);
+
+        if(it == mStaticFunctions.end()) {
+            try {
+                it = mStaticFunctions.emplace(name, std::make_shared<StaticFunction>(name, cInfo, addr)).first;
+            } catch(const StaticFunction::Exception& ex) {
+                std::cerr << format("[WARNING] Could not hook function '%s': %s\n") % name % ex.what();
+                return nullptr;
+            }
+        } else if(cInfo < it->second->GetConventionInfo() || it->second->GetConventionInfo() < cInfo) {
+            std::cerr << format("[WARNING] A plugin tried to hook function '%s' with a different signature\n") % name;
+            return nullptr;
+        }
+
+        try {
+            // The detour is applied by the first module, and no module is kept if that fails
+            return it->second->GetModule(id);
+        } catch(const Function::Exception& ex) {
+            std::cerr << format("[WARNING] Could not hook function '%s': %s\n") % name % ex.what();
+            return nullptr;
+        }
+    }
+
+    IModuleFunction* GoldHook::GetVirtualFunction(PluginId id, const char* name, void* object, unsigned int index, const Signature& signature) {
+        if(name == nullptr || std::strlen(name) == 0 || object == nullptr) {
+            std::cerr << "[WARNING] A plugin called 'GetVirtualFunction' with an empty name or object\n";
+            return nullptr;
+        }
+
+        ConventionInfo cInfo;
+
+        if(!DescribeConvention(name, signature, cInfo)) {
+            return nullptr;
+        }
+
+        // The virtual table is shared by all instances of the class, so they are all hooked. The slot identifies
+        // the hook, since two hooks of the same slot would each replace it with their own handler.
+        void** vtable = *reinterpret_cast<void***>(object);
+        void** slot = &vtable[index];
+
+        auto known = mVirtualSlots.emplace(name, slot).first;
+
+        if(known->second != slot) {
+            std::cerr << format("[WARNING] A plugin used the name '%s' for two different virtual functions\n") % name;
+        }
+
+        auto it = mVirtualFunctions.find(slot);
+
+        if(it == mVirtualFunctions.end()) {
+            try {
+                it = mVirtualFunctions.emplace(slot, std::make_shared<VirtualFunction>(name, cInfo, vtable, index)).first;
+            } catch(const VirtualFunction::Exception& ex) {
+                std::cerr << format("[WARNING] Could not hook virtual function '%s': %s\n") % name % ex.what();
+                return nullptr;
+            }
+        } else if(cInfo < it->second->GetConventionInfo() || it->second->GetConventionInfo() < cInfo) {
+            std::cerr << format("[WARNING] A plugin tried to hook virtual function '%s' with a different signature\n") % name;
+            return nullptr;
+        }
+
+        try {
+            return it->second->GetModule(id);
+        } catch(const Function::Exception& ex) {
+            std::cerr << format("[WARNING] Could not hook virtual function '%s': %s\n") % name % ex.what();
+            return nullptr;
+        }
+    }
+
+    IModuleFunction* GoldHook::GetInstanceFunction(PluginId id, const char* name, void* object, unsigned int index, unsigned int slotCount, const Signature& signature) {
+        if(name == nullptr || std::strlen(name) == 0 || object == nullptr) {
+            std::cerr << "[WARNING] A plugin called 'GetInstanceFunction' with an empty name or object\n";
+            return nullptr;
+        }
+
+        // Each object has its own table, so the slot is identified by the object rather than the name
+        ConventionInfo cInfo;
+
+        if(!DescribeConvention(name, signature, cInfo)) {
+            return nullptr;
+        }
+
+        auto key = std::make_pair(object, index);
+        auto it = mInstanceFunctions.find(key);
+
+        if(it == mInstanceFunctions.end()) {
+            try {
+                it = mInstanceFunctions.emplace(key, std::make_shared<InstanceFunction>(name, cInfo, object, index, slotCount)).first;
+            } catch(const InstanceFunction::Exception& ex) {
+                std::cerr << format("[WARNING] Could not hook instance function '%s': %s\n") % name % ex.what();
+                return nullptr;
+            }
+        } else if(cInfo < it->second->GetConventionInfo() || it->second->GetConventionInfo() < cInfo) {
+            std::cerr << format("[WARNING] A plugin tried to hook instance function '%s' with a different signature\n") % name;
+            return nullptr;
+        }
+
+        try {
+            return it->second->GetModule(id);
+        } catch(const Function::Exception& ex) {
+            std::cerr << format("[WARNING] Could not hook instance function '%s': %s\n") % name % ex.what();
+            return nullptr;
+        }
+    }
+
+    IModuleFunction* GoldHook::GetImportFunction(PluginId id, const char* module, const char* symbol, const Signature& signature) {
+        if(module == nullptr || symbol == nullptr || std::strlen(symbol) == 0) {
+            std::cerr << "[WARNING] A plugin called 'GetImportFunction' with an empty symbol\n";
+            return nullptr;
+        }
+
+        // Each module has its own import table, so the same symbol can be hooked once per module
+        std::string name = str(format("%s!%s") % module % symbol);
+        ConventionInfo cInfo;
+
+        if(!DescribeConvention(name.c_str(), signature, cInfo)) {
+            return nullptr;
+        }
+
+        auto it = mImportFunctions.find(name);
+
+        if(it == mImportFunctions.end()) {
+            try {
+                it = mImportFunctions.emplace(name, std::make_shared<ImportFunction>(name, cInfo, module, symbol)).first;
+            } catch(const ImportFunction::Exception& ex) {
+                std::cerr << format("[WARNING] Could not hook imported function '%s': %s\n") % name % ex.what();
+                return nullptr;
+            }
+        } else if(cInfo < it->second->GetConventionInfo() || it->second->GetConventionInfo() < cInfo) {
+            std::cerr << format("[WARNING] A plugin tried to hook imported function '%s' with a different signature\n") % name;
+            return nullptr;
+        }
+
+        try {
+            return it->second->GetModule(id);
+        } catch(const Function::Exception& ex) {
+            std::cerr << format("[WARNING] Could not hook imported function '%s': %s\n") % name % ex.what();
+            return nullptr;
+        }
+    }
+
+    IMidHook* GoldHook::GetMidHook(PluginId id, void* address) {
+        if(address == nullptr) {
+            std::cerr << "[WARNING] A plugin called 'GetMidHook' with an empty address\n";
+            return nullptr;
+        }
+
+        auto it = mMidFunctions.find(address);
+
+        if(it == mMidFunctions.end()) {
+            try {
+                it = mMidFunctions.emplace(address, std::make_shared<MidFunction>(address)).first;
+            } catch(const MidFunction::Exception& ex) {
+                std::cerr << format("[WARNING] Could not hook instruction at %p: %s\n") % address % ex.what();
+                return nullptr;
+            }
+        }
+
+        try {
+            return it->second->GetModule(id);
+        } catch(const MidFunction::Exception& ex) {
+            std::cerr << format("[WARNING] Could not hook instruction at %p: %s\n") % address % ex.what();
+            return nullptr;
+        }
+    }
+
     IModuleFunction* GoldHook::GetEngineFunction(PluginId id, EngineAPI function) {
         static const std::map<EngineAPI, std::string> mapping = {
             { EngineAPI::PrecacheModel, "PrecacheModel" },
@@ -9,6 +9,10 @@
 #include "PathManager.hpp"
 #include "GoldHook/DataType.hpp"
 #include "GoldHook/StaticFuntion.hpp"
+#include "GoldHook/VirtualFunction.hpp"
+#include "GoldHook/InstanceFunction.hpp"
+#include "GoldHook/ImportFunction.hpp"
+#include "GoldHook/MidFunction.hpp"
 
 namespace /* Anonymous */ {
     namespace fs = boost::filesystem;
@@ -37,6 +41,31 @@ namespace gm {
         /// </summary>
         virtual IModuleFunction* GetEngineFunction(PluginId id, EngineAPI function);
 
+        /// <summary>
+        /// Gets a function handler for a custom function with a known signature
+        /// </summary>
+        virtual IModuleFunction* GetFunction(PluginId id, const char* name, void* addr, const Signature& signature);
+
+        /// <summary>
+        /// Gets a function handler for a virtual function, by replacing a slot of the object's virtual table
+        /// </summary>
+        virtual IModuleFunction* GetVirtualFunction(PluginId id, const char* name, void* object, unsigned int index, const Signature& signature);
+
+        /// <summary>
+        /// Gets a function handler for a virtual function of a single object, by giving it a shadow virtual table
+        /// </summary>
+        virtual IModuleFunction* GetInstanceFunction(PluginId id, const char* name, void* object, unsigned int index, unsigned int slotCount, const Signature& signature);
+
+        /// <summary>
+        /// Gets a function handler for a symbol imported by a module, by replacing its import table slot
+        /// </summary>
+        virtual IModuleFunction* GetImportFunction(PluginId id, const char* module, const char* symbol, const Signature& signature);
+
+        /// <summary>
+        /// Gets a hook for an instruction within a function, which gives its listeners the registers at that point
+        /// </summary>
+        virtual IMidHook* GetMidHook(PluginId id, void* address);
+
         /// <summary>
         ///
         /// </summary>
@@ -51,6 +80,11 @@ namespace gm {
         // Private members
         std::shared_ptr<PathManager> mPathManager;
         std::map<std::string, std::shared_ptr<StaticFunction>> mStaticFunctions;
+        std::map<void**, std::shared_ptr<VirtualFunction>> mVirtualFunctions; /* By the address of the slot */
+        std::map<std::string, void**> mVirtualSlots;                            /* The slot each name was first used for */
+        std::map<std::pair<void*, unsigned int>, std::shared_ptr<InstanceFunction>> mInstanceFunctions;
+        std::map<std::string, std::shared_ptr<ImportFunction>> mImportFunctions;
+        std::map<void*, std::shared_ptr<MidFunction>> mMidFunctions;
         std::map<std::string, DataType> mTypes;
     };
 }
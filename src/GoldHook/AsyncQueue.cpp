@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <cstring>
+#include <thread>
+#include <new>
+
+#include "AsyncQueue.hpp"
+
+namespace /* Anonymous */ {
+    /// <summary>
+    /// The worker thread (its state is guarded by the registry mutex), which must have
+    /// been stopped by 'AsyncQueue::Shutdown' before the library's code is unloaded
+    /// </summary>
+    struct Worker {
+        std::thread thread;
+        std::condition_variable stopped;
+        bool running = false;
+        bool stopping = false;
+    };
+
+    // The registry is only locked briefly, while the delivery mutex is held during listener calls
+    std::mutex gRegistryMutex;
+    std::recursive_mutex gDeliveryMutex;
+    std::vector<std::shared_ptr<gm::AsyncQueue>> gQueues;
+    Worker gWorker;
+}
+
+namespace gm {
+    AsyncQueue::AsyncQueue(const std::string& name, const ConventionInfo& cInfo) :
+        mName(name),
+        mConventionInfo(cInfo),
+        mEnqueuePosition(0),
+        mDequeuePosition(0),
+        mDropped(0),
+        mTargets(std::make_shared<std::vector<AsyncTarget>>()),
+        mLastWarning(std::chrono::steady_clock::now()),
+        mUnreported(0),
+        mRegistered(true)
+    {
+        const std::vector<DataType>& parameters = mConventionInfo.GetParameters();
+
+        // The arguments are copied as they are laid out by the handler, so frames can be read as usual
+        mArgumentsSize = parameters.empty() ? 0 : mConventionInfo.GetParameterOffset(parameters.size() - 1) + parameters.back().GetStackSize();
+        mReturnSize = mConventionInfo.GetReturn().GetSize();
+
+        // Each cell is aligned to a double word, so any argument can be read in place
+        mStride = (sizeof(Cell) + mArgumentsSize + mReturnSize + 7) & ~size_t(7);
+        mRing.reset(new byte[mStride * Capacity]);
+
+        for(size_t i = 0; i < Capacity; i++) {
+            // A cell is free when its sequence equals the position that may be written to it
+            new (this->GetCell(i)) Cell();
+            this->GetCell(i)->sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    AsyncQueue::~AsyncQueue() {
+        for(size_t i = 0; i < Capacity; i++) {
+            this->GetCell(i)->~Cell();
+        }
+    }
+
+    bool AsyncQueue::Push(const byte* arguments, const byte* returnValue, void* callerAddress, void* object) {
+        size_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+
+        // Each producer claims a position, and the cell is published once it has been filled
+        for(;;) {
+            cell = this->GetCell(position);
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+            if(difference == 0) {
+                if(mEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if(difference < 0) {
+                // The worker has fallen behind, and the game thread must never wait for it
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = mEnqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        byte* payload = reinterpret_cast<byte*>(cell + 1);
+
+        cell->callerAddress = callerAddress;
+        cell->object = object;
+        std::memcpy(payload, arguments, mArgumentsSize);
+
+        if(mReturnSize > 0) {
+            std::memcpy(payload + mArgumentsSize, returnValue, mReturnSize);
+        }
+
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    void AsyncQueue::SetTargets(std::vector<AsyncTarget> targets) {
+        {
+            std::lock_guard<std::mutex> lock(mTargetMutex);
+            mTargets = std::make_shared<const std::vector<AsyncTarget>>(std::move(targets));
+        }
+
+        // A delivery in progress may still use the previous listeners, so wait until it is finished
+        std::lock_guard<std::recursive_mutex> delivery(gDeliveryMutex);
+    }
+
+    void AsyncQueue::Register(std::shared_ptr<AsyncQueue> queue) {
+        std::lock_guard<std::mutex> lock(gRegistryMutex);
+        gQueues.push_back(std::move(queue));
+
+        if(!gWorker.running && !gWorker.stopping) {
+            // The previous worker has exited (or is about to), since it found no queues
+            if(gWorker.thread.joinable()) {
+                gWorker.thread.join();
+            }
+
+            gWorker.running = true;
+            gWorker.thread = std::thread(&AsyncQueue::Run);
+        }
+    }
+
+    void AsyncQueue::Unregister(AsyncQueue* queue) {
+        {
+            std::lock_guard<std::mutex> lock(gRegistryMutex);
+
+            gQueues.erase(std::remove_if(gQueues.begin(), gQueues.end(), [queue](const std::shared_ptr<AsyncQueue>& entry) {
+                return entry.get() == queue;
+            }), gQueues.end());
+        }
+
+        // The listeners may belong to a plugin that is about to be unloaded, and the worker may still
+        // hold its own reference to the queue, so it must not deliver anything once this returns.
+        std::lock_guard<std::recursive_mutex> delivery(gDeliveryMutex);
+        queue->mRegistered = false;
+    }
+
+    void AsyncQueue::Shutdown() {
+        std::unique_lock<std::mutex> lock(gRegistryMutex);
+        gWorker.stopping = true;
+
+        // The worker checks the flag between deliveries, so it is left after the current one
+        gWorker.stopped.wait(lock, [] { return !gWorker.running; });
+        lock.unlock();
+
+        if(gWorker.thread.joinable()) {
+#ifdef _WIN32
+            // This is called while the loader lock is held, which a thread needs in order to exit, so it
+            // cannot be joined. It has already left the worker procedure, and only has its startup code left to return through.
+            gWorker.thread.detach();
+#else
+            gWorker.thread.join();
+#endif
+        }
+    }
+
+    bool AsyncQueue::Deliver() {
+        const size_t payloadSize = mArgumentsSize + mReturnSize;
+        size_t count = 0;
+
+        mBatchData.resize(payloadSize * Capacity);
+        mBatch.clear();
+
+        // Only the calls that were pending when the delivery started are taken, so it always ends
+        for(; count < Capacity; count++) {
+            Cell* cell = this->GetCell(mDequeuePosition);
+
+            if(cell->sequence.load(std::memory_order_acquire) != mDequeuePosition + 1) {
+                break;
+            }
+
+            byte* data = mBatchData.data() + count * payloadSize;
+            std::memcpy(data, cell + 1, payloadSize);
+
+            AsyncCall call;
+            call.arguments = reinterpret_cast<const ArgFrame*>(data);
+            call.returnValue = (mReturnSize > 0) ? data + mArgumentsSize : nullptr;
+            call.callerAddress = cell->callerAddress;
+            call.object = cell->object;
+            mBatch.push_back(call);
+
+            // The cell is free again once the position wraps around
+            cell->sequence.store(mDequeuePosition + Capacity, std::memory_order_release);
+            mDequeuePosition++;
+        }
+
+        this->ReportDropped();
+
+        if(count == 0) {
+            return false;
+        }
+
+        std::shared_ptr<const std::vector<AsyncTarget>> targets;
+
+        {
+            std::lock_guard<std::mutex> lock(mTargetMutex);
+            targets = mTargets;
+        }
+
+        for(const AsyncTarget& target : *targets) {
+            if(target.callerRanges.empty() && target.predicates.empty() && !target.sampler.IsEnabled()) {
+                target.callback(target.context, mBatch.data(), static_cast<unsigned int>(mBatch.size()));
+                continue;
+            }
+
+            // The filters are applied here instead of by the handler, since they cost the game thread nothing
+            mFiltered.clear();
+
+            for(const AsyncCall& call : mBatch) {
+                if(ModuleFunction::AcceptsCaller(target.callerRanges, call.callerAddress) &&
+                    ModuleFunction::AcceptsArguments(target.predicates, mConventionInfo, reinterpret_cast<const byte*>(call.arguments)) && target.sampler.Sample()) {
+                    mFiltered.push_back(call);
+                }
+            }
+
+            if(!mFiltered.empty()) {
+                target.callback(target.context, mFiltered.data(), static_cast<unsigned int>(mFiltered.size()));
+            }
+        }
+
+        return true;
+    }
+
+    void AsyncQueue::ReportDropped() {
+        mUnreported += mDropped.exchange(0, std::memory_order_relaxed);
+
+        if(mUnreported == 0) {
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+
+        if(now - mLastWarning >= std::chrono::seconds(WarningInterval)) {
+            std::cerr << format("[WARNING] %d calls of function '%s' were not delivered to asynchronous listeners, since they could not keep up\n") % mUnreported % mName;
+            mLastWarning = now;
+            mUnreported = 0;
+        }
+    }
+
+    void AsyncQueue::Run() {
+        for(;;) {
+            std::vector<std::shared_ptr<AsyncQueue>> queues;
+
+            {
+                std::lock_guard<std::mutex> lock(gRegistryMutex);
+
+                if(gQueues.empty() || gWorker.stopping) {
+                    // The next registration starts a new worker (unless the library is shutting down)
+                    gWorker.running = false;
+                    gWorker.stopped.notify_all();
+                    return;
+                }
+
+                queues = gQueues;
+            }
+
+            bool delivered = false;
+
+            for(auto& queue : queues) {
+                std::lock_guard<std::recursive_mutex> delivery(gDeliveryMutex);
+
+                if(queue->mRegistered) {
+                    delivered |= queue->Deliver();
+                }
+            }
+
+            if(!delivered) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(DeliveryInterval));
+            }
+        }
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <GoldMeta/Gold/AsyncCall.hpp>
+#include <memory>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#include "ConventionInfo.hpp"
+#include "ModuleFunction.hpp"
+#include "../Default.hpp"
+
+namespace gm {
+    /// <summary>
+    /// An asynchronous listener, with the filters of its module as they were when it was set
+    /// </summary>
+    struct AsyncTarget {
+        AsyncListener callback;
+        void* context;
+        std::vector<CallerRange> callerRanges;
+        std::vector<ArgPredicate> predicates;
+        mutable Sampler sampler; /* Only advanced by the worker */
+    };
+
+    /// <summary>
+    /// A bounded ring of call snapshots for one function. Any thread may push without locking, and the
+    /// worker thread delivers them to the function's asynchronous listeners in batches. Listeners must
+    /// not modify hooks, since that waits for the delivery to finish.
+    /// </summary>
+    class AsyncQueue {
+    public:
+        /// <summary>
+        /// The number of calls that can be pending (further calls are dropped until there is room)
+        /// </summary>
+        static const size_t Capacity = 1024;
+
+        /// <summary>
+        /// How long the worker sleeps when there is nothing to deliver (in milliseconds)
+        /// </summary>
+        static const size_t DeliveryInterval = 5;
+
+        /// <summary>
+        /// The minimum time between warnings about dropped calls (in seconds)
+        /// </summary>
+        static const size_t WarningInterval = 10;
+
+        /// <summary>
+        /// Constructs a queue for the calls of a function
+        /// </summary>
+        AsyncQueue(const std::string& name, const ConventionInfo& cInfo);
+
+        /// <summary>
+        /// Destructor for the queue
+        /// </summary>
+        ~AsyncQueue();
+
+        /// <summary>
+        /// Copies a call to the queue, returning false if it was full (this never blocks)
+        /// </summary>
+        bool Push(const byte* arguments, const byte* returnValue, void* callerAddress, void* object);
+
+        /// <summary>
+        /// Replaces the listeners, returning once the worker no longer calls the previous ones
+        /// </summary>
+        void SetTargets(std::vector<AsyncTarget> targets);
+
+        /// <summary>
+        /// Makes the worker deliver the calls of a queue until it is unregistered (the worker is started if needed)
+        /// </summary>
+        static void Register(std::shared_ptr<AsyncQueue> queue);
+
+        /// <summary>
+        /// Stops the worker from delivering the calls of a queue, returning once it no longer does
+        /// </summary>
+        static void Unregister(AsyncQueue* queue);
+
+        /// <summary>
+        /// Stops the worker for good, returning once it no longer executes any of the library's code
+        /// (this must be called before the library is unloaded, and queues are no longer delivered after it)
+        /// </summary>
+        static void Shutdown();
+
+    private:
+        /// <summary>
+        /// The header of each element within the ring (followed by the arguments and the return value)
+        /// </summary>
+        struct Cell {
+            std::atomic<size_t> sequence;
+            void* callerAddress;
+            void* object;
+        };
+
+        /// <summary>
+        /// Delivers the pending calls to the listeners (only called by the worker), returning whether there were any
+        /// </summary>
+        bool Deliver();
+
+        /// <summary>
+        /// Gets the cell at a ring position
+        /// </summary>
+        Cell* GetCell(size_t position) const;
+
+        /// <summary>
+        /// The worker thread's procedure
+        /// </summary>
+        static void Run();
+
+        /// <summary>
+        /// Warns about dropped calls, at most once per interval
+        /// </summary>
+        void ReportDropped();
+
+        // Private members
+        std::string mName;
+        ConventionInfo mConventionInfo;
+        std::unique_ptr<byte[]> mRing;
+        size_t mArgumentsSize;
+        size_t mReturnSize;
+        size_t mStride;
+        std::atomic<size_t> mEnqueuePosition;
+        size_t mDequeuePosition;
+        std::atomic<size_t> mDropped;
+        std::vector<byte> mBatchData;
+        std::vector<AsyncCall> mBatch;
+        std::vector<AsyncCall> mFiltered;
+        std::chrono::steady_clock::time_point mLastWarning;
+        size_t mUnreported;
+        bool mRegistered; /* Guarded by the delivery mutex */
+        std::shared_ptr<const std::vector<AsyncTarget>> mTargets;
+        std::mutex mTargetMutex;
+    };
+
+    inline AsyncQueue::Cell* AsyncQueue::GetCell(size_t position) const {
+        return reinterpret_cast<Cell*>(mRing.get() + (position % Capacity) * mStride);
+    }
+}
@@ -0,0 +1,55 @@
+#include <map>
+#include <mutex>
+
+#include "CodeCache.hpp"
+#include "CodeGenerator.hpp"
+
+namespace /* Anonymous */ {
+    /// <summary>
+    /// The shared code for one convention info
+    /// </summary>
+    struct CacheEntry {
+        std::weak_ptr<void> callHook;
+        std::weak_ptr<void> hookHandler;
+    };
+
+    // Code is only generated when hooks are modified, so a lock is fine here
+    std::mutex gCacheMutex;
+    std::map<gm::ConventionInfo, CacheEntry> gCache;
+
+    template <typename Emit>
+    std::shared_ptr<void> GetOrEmit(const gm::ConventionInfo& cInfo, std::weak_ptr<void> CacheEntry::* member, Emit emit) {
+        std::lock_guard<std::mutex> lock(gCacheMutex);
+        CacheEntry& entry = gCache[cInfo];
+
+        // The code is owned by the functions using it, so it is released with the last of them
+        std::shared_ptr<void> code = (entry.*member).lock();
+
+        if(!code) {
+            gm::CodeGenerator generator(cInfo);
+            code = emit(generator);
+            entry.*member = code;
+        }
+
+        // Remove any entries whose code has been released in the meantime
+        for(auto it = gCache.begin(); it != gCache.end();) {
+            if(it->second.callHook.expired() && it->second.hookHandler.expired()) {
+                it = gCache.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        return code;
+    }
+}
+
+namespace gm {
+    std::shared_ptr<void> CodeCache::GetCallHook(const ConventionInfo& cInfo) {
+        return GetOrEmit(cInfo, &CacheEntry::callHook, [](CodeGenerator& generator) { return generator.EmitCallHook(); });
+    }
+
+    std::shared_ptr<void> CodeCache::GetHookHandler(const ConventionInfo& cInfo) {
+        return GetOrEmit(cInfo, &CacheEntry::hookHandler, [](CodeGenerator& generator) { return generator.EmitHookHandler(); });
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <memory>
+
+#include "ConventionInfo.hpp"
+
+namespace gm {
+    class CodeCache {
+    public:
+        /// <summary>
+        /// Gets the call hook for a convention info (it is generated if no function uses it yet)
+        /// </summary>
+        static std::shared_ptr<void> GetCallHook(const ConventionInfo& cInfo);
+
+        /// <summary>
+        /// Gets the generic hook handler for a convention info (it is generated if no function uses it yet)
+        /// </summary>
+        static std::shared_ptr<void> GetHookHandler(const ConventionInfo& cInfo);
+    };
+}
@@ -1,347 +1,845 @@
 #include <asmjit/asmjit.h>
 #include <GoldMeta/Gold/IModuleFunction.hpp>
+#include <GoldMeta/Gold/IMidHook.hpp>
 #include <boost/range/adaptor/reversed.hpp>
+#include <algorithm>
 #include <cstddef>
 #include <cassert>
 #include <vector>
+#include <mutex>
+#include <map>
 
 #include "../Default.hpp"
 #include "HookContext.hpp"
+#include "CodeCache.hpp"
 #include "CodeGenerator.hpp"
+#include "Epoch.hpp"
 #include "VTableOffset.hpp"
+#include "../OS/CodeArena.hpp"
 
 // We want to keep these to a minimum
 using namespace asmjit;
 using namespace asmjit::host;
 
+namespace /* Anonymous */ {
+    // The exit stubs by their stack size (and whether they are tail calls), which are never released
+    std::mutex gExitStubMutex;
+    std::map<std::pair<size_t, bool>, void*> gExitStubs;
+}
+
 namespace gm {
     CodeGenerator::CodeGenerator(IFunctionBase* function) :
+        CodeGenerator(function->GetConventionInfo())
+    {
+        mFunctionBase = function;
+    }
+
+    CodeGenerator::CodeGenerator(const ConventionInfo& cInfo) :
         mAssembler(new Assembler(&mJitRuntime)),
         mHasNonHiddenReturn(false),
-        mFunctionBase(function),
-        mLastArgument(0)
+        mFunctionBase(nullptr),
+        mConventionInfo(cInfo),
+        mLocality(nullptr),
+        mHasArgumentBlock(false),
+        mMemoized(false),
+        mAsyncCapture(false),
+        mArgumentsSize(0),
+        mArgumentBase(0)
     {
-        assert(mFunctionBase != nullptr);
         assert(mAssembler);
 
-        mConventionInfo = mFunctionBase->GetConventionInfo();
         mHasNonHiddenReturn = mConventionInfo.GetReturnMethod() != ReturnMethod::Hidden && mConventionInfo.GetReturn().GetType() != DataType::Void;
 
-        // Calculate where the first argument will be relative to EBP
         for(const DataType& parameter : mConventionInfo.GetParameters()) {
-            mLastArgument += parameter.GetStackSize();
+            mArgumentsSize += parameter.GetStackSize();
+        }
+
+        // Parameters passed in registers are spilled together with the stack arguments to a block below the
+        // preserved registers, so modules can access them as if they were all passed on the stack.
+        mHasArgumentBlock = mConventionInfo.HasRegisterParameters();
+
+        if(mHasArgumentBlock) {
+            mArgumentBase = -static_cast<int>(3 * sizeof(uintptr_t) + mArgumentsSize);
+        } else {
+            // The first argument follows the saved EBP, the caller address and the hidden return address
+            mArgumentBase = 2 * sizeof(uintptr_t);
+
+            if(mConventionInfo.GetReturnMethod() == ReturnMethod::Hidden) {
+                mArgumentBase += sizeof(uintptr_t);
+            }
         }
     }
 
     FNCallHook CodeGenerator::GenerateCallHook() {
         if(!mCallHook) {
-            mAssembler->clear();
+            // The call hook does not depend on the function, so it is shared by all with the same signature
+            mCallHook = CodeCache::GetCallHook(mConventionInfo);
+        }
 
-            // We use this to avoid to several memory accesses
-            Label callerContext = mAssembler->newLabel();
+        return reinterpret_cast<FNCallHook>(mCallHook.get());
+    }
 
-            mAssembler->push(ebp);
-            mAssembler->mov(ebp, esp);
+    void* CodeGenerator::GenerateHookHandler() {
+        if(!mHookHandler) {
+            if(mConventionInfo.UsesRegister(Location::EAX)) {
+                // Shared handlers are entered with the function in EAX, so a parameter cannot be passed in it
+                assert(mFunctionBase != nullptr);
+                mHookHandler = this->EmitHookHandler();
+            } else {
+                // The generic handler retrieves the function from the hook context, so it can be shared as well
+                mHookHandler = CodeCache::GetHookHandler(mConventionInfo);
+            }
+        }
 
-            // We need to push the arguments in reverse order (and the first argument should be the context, if required)
-            size_t index = mConventionInfo.GetParameters().size() + (mConventionInfo.IsMethod() ? sizeof(uintptr_t) : 0);
+        return mHookHandler.get();
+    }
 
-            if(index > 0) {
-                // Copy the 'arguments' array pointer to EDX
-                mAssembler->mov(edx, dword_ptr(ebp, 12));
+    std::shared_ptr<void> CodeGenerator::EmitCallHook() {
+        mAssembler->clear();
 
-                for(const DataType& parameter : mConventionInfo.GetParameters()) {
-                    mAssembler->mov(eax, ptr(edx, --index * sizeof(uintptr_t)));
-                    this->PushParameter(parameter, ptr(eax));
-                }
+        mAssembler->push(ebp);
+        mAssembler->mov(ebp, esp);
+
+        // These are used when copying parameters, and they need to be preserved
+        mAssembler->push(esi);
+        mAssembler->push(edi);
+
+        const std::vector<DataType>& parameters = mConventionInfo.GetParameters();
+
+        // The first element of the 'arguments' array is the context, if required
+        size_t firstIndex = mConventionInfo.IsMethod() ? 1 : 0;
 
-                if(mConventionInfo.IsMethod()) {
-                    mAssembler->mov(eax, dword_ptr(edx, 0));
-                    mAssembler->mov(eax, dword_ptr(eax));
-                    mAssembler->mov(dword_ptr(callerContext), eax);
+        if(parameters.size() + firstIndex > 0) {
+            // Copy the 'arguments' array pointer to EDX
+            mAssembler->mov(edx, dword_ptr(ebp, 16));
+
+            // We need to push the arguments in reverse order
+            for(size_t i = parameters.size(); i-- > 0;) {
+                if(mConventionInfo.GetParameterLocation(i) == Location::Stack) {
+                    mAssembler->mov(eax, ptr(edx, (firstIndex + i) * sizeof(uintptr_t)));
+                    this->PushParameter(parameters[i], ptr(eax, parameters[i].GetStackSize() - sizeof(uintptr_t)));
                 }
             }
 
-            // Call 'IFunctionBase::GetCallableAddress' to retrieve the address that we should use
-            // for calling the original function. The result will be stored in EAX for later usage.
-            mAssembler->mov(ecx, reinterpret_cast<uintptr_t>(mFunctionBase));
-            mAssembler->mov(eax, dword_ptr(ecx));
-            mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::GetCallableAddress)));
-
             if(mConventionInfo.IsMethod()) {
                 // If it is a method, we need to supply the context
-                mAssembler->mov(ecx, dword_ptr(callerContext));
+                mAssembler->mov(ecx, dword_ptr(edx, 0));
+                mAssembler->mov(ecx, dword_ptr(ecx));
             }
+        }
 
-            if(mConventionInfo.GetReturnMethod() == ReturnMethod::Hidden) {
-                // If the return is done by a hidden parameter, push it!
-                mAssembler->push(dword_ptr(ebp, 8));
-            }
+        if(mConventionInfo.GetReturnMethod() == ReturnMethod::Hidden) {
+            // If the return is done by a hidden parameter, push it!
+            mAssembler->push(dword_ptr(ebp, 12));
+        }
 
-            // Call the original function
-            mAssembler->call(eax);
+        for(size_t i = 0; i < parameters.size(); i++) {
+            Location location = mConventionInfo.GetParameterLocation(i);
+
+            if(location != Location::Stack) {
+                // Each register is loaded through itself, since EDX may be one of them
+                const GpReg& reg = GetRegister(location);
 
-            if(!mConventionInfo.IsCalleClean()) {
-                mAssembler->add(esp, mConventionInfo.GetStackSize());
+                mAssembler->mov(reg, dword_ptr(ebp, 16));
+                mAssembler->mov(reg, dword_ptr(reg, (firstIndex + i) * sizeof(uintptr_t)));
+                this->LoadParameter(parameters[i], location, ptr(reg));
             }
+        }
 
-            if(mConventionInfo.GetReturn().GetType() != DataType::Void) {
-                // Copy the source address to the EAX register
-                mAssembler->mov(ecx, dword_ptr(ebp, 8));
+        // Call the original function, using the callable address supplied by the caller
+        mAssembler->call(dword_ptr(ebp, 8));
 
-                if(mHasNonHiddenReturn == true) {
-                    this->SaveReturn(mConventionInfo.GetReturn(), ptr(ecx));
-                }
+        if(!mConventionInfo.IsCalleClean()) {
+            mAssembler->add(esp, mConventionInfo.GetStackSize());
+        }
+
+        if(mHasNonHiddenReturn && mConventionInfo.GetReturnLocation() != Location::EAX) {
+            mAssembler->mov(eax, GetRegister(mConventionInfo.GetReturnLocation()));
+        }
+
+        if(mConventionInfo.GetReturn().GetType() != DataType::Void) {
+            // Copy the destination address to the ECX register
+            mAssembler->mov(ecx, dword_ptr(ebp, 12));
+
+            if(mHasNonHiddenReturn == true) {
+                this->SaveReturn(mConventionInfo.GetReturn(), ptr(ecx));
             }
+        }
 
-            mAssembler->pop(ebp);
-            mAssembler->ret(8);
+        mAssembler->pop(edi);
+        mAssembler->pop(esi);
+        mAssembler->pop(ebp);
+        mAssembler->ret(12);
 
-            // ------------------------------------------------------
+        // Retrieve the assembly code, ready for execution
+        return this->MakeCode();
+    }
 
-            if(mConventionInfo.IsMethod()) {
-                mAssembler->bind(callerContext);
-                mAssembler->dptr(nullptr);
+    std::shared_ptr<void> CodeGenerator::EmitHookHandler() {
+        // The generic handler looks up each module at runtime
+        this->GenerateHandlerBody([this](Tense::Type tense) { this->CallModules(tense); });
+        return this->MakeCode();
+    }
+
+    std::shared_ptr<void> CodeGenerator::GenerateSpecializedHandler(const std::vector<ModuleFunction*>& pre, const std::vector<ModuleFunction*>& post) {
+        // The modules are embedded in the assembly, so this handler is only valid until a module changes
+        mSampledPairs.clear();
+
+        for(ModuleFunction* module : pre) {
+            // A sampled listener is called in post for the calls it was called for in pre
+            if(module->GetSampler()->IsEnabled() && std::find(post.begin(), post.end(), module) != post.end() && mSampledPairs.size() < HookContext::MaxSampledPairs) {
+                mSampledPairs.push_back(module);
             }
+        }
 
-            // Retrieve the assembly code, ready for execution
-            mCallHook.reset(mAssembler->make(), [](void* code) { MemoryManager::getGlobal()->release(code); });
+        if(post.empty() && !mMemoized && !mAsyncCapture) {
+            this->GeneratePreHandlerBody(pre);
+        } else {
+            this->GenerateHandlerBody([&](Tense::Type tense) { this->CallModules(tense, (tense == Tense::Pre) ? pre : post); });
         }
 
-        return reinterpret_cast<FNCallHook>(mCallHook.get());
+        return this->MakeCode();
     }
 
-    void* CodeGenerator::GenerateHookHandler() {
-        if(!mHookHandler) {
+    void* CodeGenerator::GenerateDispatcher(std::atomic<void*>* target) {
+        if(!mDispatcher) {
             mAssembler->clear();
 
-            // Because hooks can be called recursively, we cannot store any data in the assembly, so we only store it
-            // temporarily at these label addresses until we have received a hook context, then we copy the values.
-            Label returnData     = mAssembler->newLabel();
-            Label callerAddress  = mAssembler->newLabel();
-            Label calleeContext  = mAssembler->newLabel();
-            Label skipOrigCall   = mAssembler->newLabel();
-            Label returnToCaller = mAssembler->newLabel();
-            Label skipCopyReturn = mAssembler->newLabel();
+            // The detour always points at this stub, so the handler can be replaced with a single aligned store
+            mAssembler->jmp(dword_ptr_abs(reinterpret_cast<Ptr>(target)));
+            mDispatcher = this->MakeCode();
+        }
 
-            // Save the callback address for later
-            mAssembler->pop(dword_ptr(callerAddress));
+        return mDispatcher.get();
+    }
 
-            if(mConventionInfo.IsMethod()) {
-                // The object instance is in ecx, so copy it to the hook context
-                mAssembler->mov(dword_ptr(calleeContext), ecx);
-            }
+    void* CodeGenerator::GenerateEntryStub() {
+        if(!mEntryStub) {
+            mAssembler->clear();
 
-            if(mConventionInfo.GetReturnMethod() == ReturnMethod::Hidden) {
-                // We need the return address for later
-                mAssembler->pop(dword_ptr(returnData));
+            // These may contain parameters ('thiscall', 'fastcall' or custom locations)
+            bool preserveEax = mConventionInfo.UsesRegister(Location::EAX);
+
+            if(preserveEax) {
+                mAssembler->push(eax);
             }
 
-            // Call the function method 'OnEntry'. This function setups some necessary data, but above all,
-            // it returns the current hook context in EAX. This is where we store all data for this call. To avoid
-            // heap allocations, the hook context is only allocated when necessary, otherwise it is reused.
+            mAssembler->push(ecx);
+            mAssembler->push(edx);
+
+            // Call 'IFunctionBase::OnDispatch' to enter the handler's epoch and retrieve its address
             mAssembler->mov(ecx, reinterpret_cast<uintptr_t>(mFunctionBase));
             mAssembler->mov(eax, dword_ptr(ecx));
-            mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::OnEntry)));
+            mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::OnDispatch)));
+
+            mAssembler->pop(edx);
+            mAssembler->pop(ecx);
+
+            // Shared handlers expect the function in EAX, so the handler address is pushed and
+            // 'returned' to instead. The stack is untouched once it has been entered.
+            if(preserveEax) {
+                // The handler is specialized for this function, so EAX keeps the parameter instead
+                mAssembler->xchg(eax, dword_ptr(esp));
+            } else {
+                mAssembler->push(eax);
+                mAssembler->mov(eax, reinterpret_cast<uintptr_t>(mFunctionBase));
+            }
+
+            mAssembler->ret();
+            mEntryStub = this->MakeCode();
+        }
 
-            // Function prolog - Normally the function parameters start at [EBP + 8], but since we have
-            // popped the caller return address from the stack, the location as been dislocated by 4 bytes.
-            // So this means that the first argument can be accessed at [EBP + 4] instead.
-            mAssembler->push(ebp);
-            mAssembler->mov(ebp, esp);
+        return mEntryStub.get();
+    }
 
-            // ------------------------------------------------------
+    void* CodeGenerator::GenerateMidHandler(void* object, void* callback, const void* resume) {
+        mAssembler->clear();
 
-            // These are not scratch registers, they need to be preserved
-            mAssembler->push(ebx);
-            mAssembler->push(esi);
-            mAssembler->push(edi);
+        // The flags are pushed first, so 'pushad' stores the registers right below them (see 'Registers')
+        mAssembler->pushfd();
+        mAssembler->pushad();
 
-            // Copy the hook context to EBX
-            mAssembler->mov(ebx, eax);
+        // 'pushad' stores ESP as it was after the flags were pushed, but listeners expect the original
+        mAssembler->add(dword_ptr(esp, offsetof(Registers, esp)), 4);
+        mAssembler->mov(eax, esp);
 
-            // Copy the caller address to the hook context
-            mAssembler->mov(eax, dword_ptr(callerAddress));
-            mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, callerAddress)), eax);
+        // Any instruction may be hooked, so the stack must be aligned for the listeners (EBX is restored by 'popad')
+        mAssembler->mov(ebx, esp);
+        mAssembler->sub(esp, FxStateSize);
+        mAssembler->and_(esp, -16);
 
-            if(mConventionInfo.IsMethod()) {
-                // Copy the callee context to the hook context
-                mAssembler->mov(eax, dword_ptr(calleeContext));
-                mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, calleeContext)), eax);
+        // The hooked code may be in the middle of using the FPU or SSE registers (or have changed their
+        // control words), none of which compiled listeners preserve, so their whole state is saved as well
+        mAssembler->fxsave(ptr(esp));
+        mAssembler->sub(esp, 8);
+
+        mAssembler->push(eax);
+        mAssembler->push(reinterpret_cast<uintptr_t>(object));
+
+        // The direction flag may be set by the hooked code, but compiled code expects it to be clear
+        mAssembler->cld();
+        mAssembler->mov(eax, reinterpret_cast<uintptr_t>(callback));
+        mAssembler->call(eax);
+
+        mAssembler->add(esp, 16);
+        mAssembler->fxrstor(ptr(esp));
+
+        // Any changes made by the listeners are restored along with the registers
+        mAssembler->mov(esp, ebx);
+        mAssembler->popad();
+        mAssembler->popfd();
+
+        // Continue with the replaced instructions within the trampoline
+        mAssembler->jmp(reinterpret_cast<Ptr>(resume));
+
+        // Threads enter the handler outside any epoch, so it is never known to be unused
+        return this->MakePermanentCode();
+    }
+
+    void CodeGenerator::GenerateHandlerBody(const std::function<void(Tense::Type)>& callModules) {
+        this->GenerateHandlerPrologue();
+
+        Label skipOrigCall   = mAssembler->newLabel();
+        Label skipCopyReturn = mAssembler->newLabel();
+        Label cached         = mAssembler->newLabel();
+
+        if(mMemoized) {
+            // A cached result supersedes the call, and it is returned without calling any module
+            this->LoadFunctionBase();
+            mAssembler->mov(eax, dword_ptr(ecx));
+            mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::OnCacheLookup)));
+            mAssembler->cmp(al, false);
+            mAssembler->jne(cached);
+        }
+
+        // Generate the assembly code for calling all modules that are listed as 'pre' hooks
+        callModules(Tense::Pre);
+
+        // Check whether we should call the original function or not.
+        mAssembler->cmp(dword_ptr(ebx, offsetof(HookContext, highestResult)), static_cast<int>(Result::Supersede));
+        mAssembler->je(skipOrigCall);
+        {
+            this->CallOriginal();
+
+            if(mHasNonHiddenReturn == true) {
+                // We need to copy the original return value to the hook context so function modules may access the value
+                mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, originalReturn)));
+                this->SaveReturn(mConventionInfo.GetReturn(), ptr(ecx));
             }
+        }
 
-            if(mConventionInfo.GetReturnMethod() == ReturnMethod::Hidden) {
-                // Copy the hidden return address to the hook context
-                mAssembler->mov(eax, dword_ptr(returnData));
-                mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, originalReturn)), eax);
+        // TODO: Avoid this useless jump for void functions
+        mAssembler->jmp(skipCopyReturn);
+        mAssembler->bind(skipOrigCall);
+
+        if(mConventionInfo.GetReturn().GetType() != DataType::Void) {
+            // The function has been superseded, so we set the original return value to the overridden one (since no original value exists)
+            mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, overrideReturn)));
+            mAssembler->mov(edx, dword_ptr(ebx, offsetof(HookContext, originalReturn)));
+            this->CopyData(mConventionInfo.GetReturn(), ptr(ecx), ptr(edx));
+        }
+
+        mAssembler->bind(skipCopyReturn);
+
+        // Generate the assembly code for calling all modules that are listed as 'post' hooks
+        callModules(Tense::Post);
+
+        if(mMemoized) {
+            this->LoadFunctionBase();
+            mAssembler->mov(eax, dword_ptr(ecx));
+            mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::OnCacheStore)));
+            mAssembler->bind(cached);
+        }
+
+        if(mAsyncCapture) {
+            // Cached calls are captured as well, since they were made all the same
+            this->LoadFunctionBase();
+            mAssembler->mov(eax, dword_ptr(ecx));
+            mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::OnAsyncCapture)));
+        }
+
+        this->GenerateHandlerEpilogue(false);
+    }
+
+    void CodeGenerator::GeneratePreHandlerBody(const std::vector<ModuleFunction*>& pre) {
+        this->GenerateHandlerPrologue();
+
+        Label skipOrigCall = mAssembler->newLabel();
+        Label overridden   = mAssembler->newLabel();
+        Label tailCall     = mAssembler->newLabel();
+
+        // There are no 'post' modules, so only the 'pre' modules are called
+        this->CallModules(Tense::Pre, pre);
+
+        // The arguments of register parameters only exist in the handler's copy, so they cannot be reused
+        bool canTailCall = !mHasArgumentBlock;
+
+        if(canTailCall) {
+            // Unless a module provided a return value (or superseded the call), the original function can
+            // return directly to the caller, using the arguments that it already pushed.
+            Result threshold = (mConventionInfo.GetReturn().GetType() == DataType::Void) ? Result::Supersede : Result::Override;
+
+            mAssembler->cmp(dword_ptr(ebx, offsetof(HookContext, highestResult)), static_cast<int>(threshold));
+            mAssembler->jb(tailCall);
+        }
+
+        mAssembler->cmp(dword_ptr(ebx, offsetof(HookContext, highestResult)), static_cast<int>(Result::Supersede));
+        mAssembler->je(skipOrigCall);
+
+        this->CallOriginal();
+
+        if(mConventionInfo.GetReturn().GetType() != DataType::Void) {
+            mAssembler->cmp(dword_ptr(ebx, offsetof(HookContext, highestResult)), static_cast<int>(Result::Override));
+            mAssembler->je(overridden);
+        }
+
+        // Nobody needs the original return value, so it is left in its registers and returned as is
+        this->GenerateHandlerEpilogue(true);
+
+        // ------------------------------------------------------
+
+        if(mConventionInfo.GetReturn().GetType() != DataType::Void) {
+            mAssembler->bind(overridden);
+
+            if(mConventionInfo.GetReturn().GetType() == DataType::FloatingPoint) {
+                // The original value must be popped from the floating point stack before it is discarded
+                mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, originalReturn)));
+                this->SaveReturn(mConventionInfo.GetReturn(), ptr(ecx));
             }
+        }
 
-            // Generate the assembly code for calling all modules that are listed as 'pre' hooks
-            this->CallModules(Tense::Pre);
+        mAssembler->bind(skipOrigCall);
 
-            // Check whether we should call the original function or not.
-            mAssembler->cmp(dword_ptr(ebx, offsetof(HookContext, highestResult)), static_cast<int>(Result::Supersede));
-            mAssembler->je(skipOrigCall);
-            {
-                size_t stackDisplacement = mLastArgument;
+        // The highest result is at least 'Override', so the overridden value is returned
+        this->GenerateHandlerEpilogue(false);
 
-                for(const DataType& parameter : boost::adaptors::reverse(mConventionInfo.GetParameters())) {
-                    // Push each function parameter to the target module, and add the EBP offset (first argument at [EBP + 4])
-                    stackDisplacement -= this->PushParameter(parameter, ptr(ebp, stackDisplacement));
-                }
+        // ------------------------------------------------------
 
-                // Call 'IFunctionBase::GetCallableAddress' to retrieve the address that we should use
-                // for calling the original function. The result will be stored in EAX for later usage.
-                mAssembler->mov(ecx, reinterpret_cast<uintptr_t>(mFunctionBase));
-                mAssembler->mov(eax, dword_ptr(ecx));
-                mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::GetCallableAddress)));
+        if(canTailCall) {
+            mAssembler->bind(tailCall);
+            this->GenerateTailCall();
+        }
+    }
 
-                if(mConventionInfo.IsMethod()) {
-                    // If it is a method, we need to supply the context
-                    mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, calleeContext)));
-                }
+    void CodeGenerator::GenerateHandlerPrologue() {
+        mAssembler->clear();
+
+        // Function prolog - Since the handler is reached with a jump from the original function, the stack
+        // looks exactly as it did when the function was called. This means that the caller address is at
+        // [EBP + 4] and the first argument (or the hidden return address) can be accessed at [EBP + 8].
+        mAssembler->push(ebp);
+        mAssembler->mov(ebp, esp);
 
-                if(mConventionInfo.GetReturnMethod() == ReturnMethod::Hidden) {
-                    // In case the return value is hidden, push the result data address
-                    mAssembler->push(dword_ptr(ebx, offsetof(HookContext, originalReturn)));
+        // ------------------------------------------------------
+
+        // These are not scratch registers, they need to be preserved
+        mAssembler->push(ebx);
+        mAssembler->push(esi);
+        mAssembler->push(edi);
+
+        if(mHasArgumentBlock) {
+            const std::vector<DataType>& parameters = mConventionInfo.GetParameters();
+            mAssembler->sub(esp, mArgumentsSize);
+
+            // The registers must be spilled before they are used for anything else
+            for(size_t i = 0; i < parameters.size(); i++) {
+                Location location = mConventionInfo.GetParameterLocation(i);
+
+                if(location != Location::Stack) {
+                    mAssembler->mov(this->GetParameterSource(i), GetRegister(location));
                 }
+            }
 
-                // Call the original function!
-                mAssembler->call(eax);
+            // The stack arguments are copied with ECX, since EAX contains the function in shared handlers
+            int stackArgument = (mConventionInfo.GetReturnMethod() == ReturnMethod::Hidden) ? 12 : 8;
 
-                if(!mConventionInfo.IsCalleClean()) {
-                    // We need to clean up the stack after us
-                    mAssembler->add(esp, mConventionInfo.GetStackSize());
+            for(size_t i = 0; i < parameters.size(); i++) {
+                if(mConventionInfo.GetParameterLocation(i) != Location::Stack) {
+                    continue;
                 }
 
-                if(mHasNonHiddenReturn == true) {
-                    // We need to copy the original return value to the hook context so function modules may access the value
-                    mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, originalReturn)));
-                    this->SaveReturn(mConventionInfo.GetReturn(), ptr(ecx));
+                int destination = mArgumentBase + static_cast<int>(mConventionInfo.GetParameterOffset(i));
+
+                for(size_t offset = 0; offset < parameters[i].GetStackSize(); offset += sizeof(uintptr_t)) {
+                    mAssembler->mov(ecx, dword_ptr(ebp, stackArgument + offset));
+                    mAssembler->mov(dword_ptr(ebp, destination + offset), ecx);
                 }
+
+                stackArgument += parameters[i].GetStackSize();
             }
+        }
 
-            // TODO: Avoid this useless jump for void functions
-            mAssembler->jmp(skipCopyReturn);
-            mAssembler->bind(skipOrigCall);
+        if(mConventionInfo.IsMethod()) {
+            // The object instance is in ECX, and it must survive the call to 'OnEntry'. Since the same
+            // handler may be executed by several threads at once, nothing is stored within the assembly.
+            mAssembler->push(ecx);
+        }
 
-            if(mConventionInfo.GetReturn().GetType() != DataType::Void) {
-                // The function has been superseded, so we set the original return value to the overridden one (since no original value exists)
-                mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, overrideReturn)));
-                mAssembler->mov(edx, dword_ptr(ebx, offsetof(HookContext, originalReturn)));
-                this->CopyData(mConventionInfo.GetReturn(), ptr(ecx), ptr(edx));
-            }
+        // Call the function method 'OnEntry'. This function setups some necessary data, but above all,
+        // it returns the current hook context in EAX. This is where we store all data for this call. To avoid
+        // heap allocations, the hook context is only allocated when necessary, otherwise it is reused.
+        if(mFunctionBase != nullptr) {
+            mAssembler->mov(ecx, reinterpret_cast<uintptr_t>(mFunctionBase));
+        } else {
+            // A shared handler is entered with the function in EAX (see 'GenerateEntryStub')
+            mAssembler->mov(ecx, eax);
+        }
+
+        mAssembler->mov(eax, dword_ptr(ecx));
+        mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::OnEntry)));
 
-            mAssembler->bind(skipCopyReturn);
+        // Copy the hook context to EBX
+        mAssembler->mov(ebx, eax);
 
-            // Generate the assembly code for calling all modules that are listed as 'post' hooks
-            this->CallModules(Tense::Post);
+        if(mConventionInfo.IsMethod()) {
+            // Copy the callee context to the hook context
+            mAssembler->pop(dword_ptr(ebx, offsetof(HookContext, calleeContext)));
+        }
 
-            // ------------------------------------------------------
+        // Copy the caller address to the hook context
+        mAssembler->mov(eax, dword_ptr(ebp, 4));
+        mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, callerAddress)), eax);
 
-            if(mConventionInfo.GetReturn().GetType() != DataType::Void) {
-                // Check whether we should use a overridden return value or the original one, returned by the function
-                mAssembler->cmp(dword_ptr(ebx, offsetof(HookContext, highestResult)), static_cast<int>(Result::Override));
-                mAssembler->cmovne(eax, dword_ptr(ebx, offsetof(HookContext, originalReturn)));
-                mAssembler->cmove(eax, dword_ptr(ebx, offsetof(HookContext, overrideReturn)));
-                mAssembler->mov(dword_ptr(returnData), eax);
-            }
+        if(mConventionInfo.GetReturnMethod() == ReturnMethod::Hidden) {
+            // Copy the hidden return address to the hook context
+            mAssembler->mov(eax, dword_ptr(ebp, 8));
+            mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, originalReturn)), eax);
+        }
 
-            // Since we pop EBX, we set the 'caller' address so we can use it later
-            mAssembler->mov(eax, dword_ptr(ebx, offsetof(HookContext, callerAddress)));
-            mAssembler->mov(dword_ptr(callerAddress), eax);
+        if(!mConventionInfo.GetParameters().empty()) {
+            // Modules may rewrite the arguments in place, so the context needs the first one's address
+            // (it follows the caller address, and the hidden return address if there is one)
+            mAssembler->lea(eax, ptr(ebp, mArgumentBase));
+            mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, arguments)), eax);
+        }
+    }
 
-            // We are going to call member functions of 'IFunctionBase'
-            mAssembler->mov(ecx, reinterpret_cast<uintptr_t>(mFunctionBase));
+    void CodeGenerator::GenerateHandlerEpilogue(bool keepReturn) {
+        Label returnToCaller = mAssembler->newLabel();
 
-            // Reset preserved registers
-            mAssembler->pop(edi);
-            mAssembler->pop(esi);
-            mAssembler->pop(ebx);
-
-            // Ensure that the stack isn't unbalanced
-            mAssembler->cmp(esp, ebp);
-            mAssembler->je(returnToCaller);
-            {
-                // If the stack has become displaced, we cannot return execution to the caller. This should
-                // actually never happen, but just in case it does, I have created a check for it. The 'InvalidESP'
-                // member function will be called and report this error and forcefully exit the application.
-                // If this happens, there is (probably) something wrong with the assembly code, or a user callback
-                // that has specified a wrong calling convention which results in an invalid ESP value.
-                mAssembler->mov(eax, dword_ptr(ecx));
-                mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::InvalidESP)));
+        const DataType& returnType = mConventionInfo.GetReturn();
+        bool preserveReturn = keepReturn && returnType.GetType() != DataType::Void;
+
+        if(preserveReturn) {
+            // The return value is still in its registers, and they must survive the call to 'OnExit'
+            if(returnType.GetType() == DataType::FloatingPoint) {
+                mAssembler->sub(esp, returnType.GetStackSize());
+                mAssembler->fstp(ptr(esp, 0, returnType.GetSize()));
+            } else {
+                mAssembler->push(eax);
+                mAssembler->push(edx);
             }
-            mAssembler->bind(returnToCaller);
-            mAssembler->pop(ebp);
+        }
 
-            // Call the 'OnExit' method
+        // Call the 'OnExit' method. The hook context belongs to this thread, and it will not
+        // be reused until this thread enters another hook, so it can still be read afterwards.
+        this->LoadFunctionBase();
+        mAssembler->mov(eax, dword_ptr(ecx));
+        mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::OnExit)));
+
+        if(preserveReturn) {
+            if(returnType.GetType() == DataType::FloatingPoint) {
+                mAssembler->fld(ptr(esp, 0, returnType.GetSize()));
+                mAssembler->add(esp, returnType.GetStackSize());
+            } else {
+                mAssembler->pop(edx);
+                mAssembler->pop(eax);
+            }
+        } else if(mHasNonHiddenReturn == true) {
+            // Check whether we should use a overridden return value or the original one, returned by the function
+            mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, originalReturn)));
+            mAssembler->cmp(dword_ptr(ebx, offsetof(HookContext, highestResult)), static_cast<int>(Result::Override));
+            mAssembler->cmovae(ecx, dword_ptr(ebx, offsetof(HookContext, overrideReturn)));
+
+            // Copy the data to the appropriate register
+            this->SetReturn(returnType, ptr(ecx));
+        } else if(returnType.GetType() != DataType::Void) {
+            Label skipOverride = mAssembler->newLabel();
+
+            // The caller provided the return storage, so an overridden value must be copied to it
+            mAssembler->cmp(dword_ptr(ebx, offsetof(HookContext, highestResult)), static_cast<int>(Result::Override));
+            mAssembler->jb(skipOverride);
+            mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, overrideReturn)));
+            mAssembler->mov(edx, dword_ptr(ebx, offsetof(HookContext, originalReturn)));
+            this->CopyData(returnType, ptr(ecx), ptr(edx));
+            mAssembler->bind(skipOverride);
+
+            // If it is a hidden return, we just need to return the pointer
+            mAssembler->mov(eax, dword_ptr(ebx, offsetof(HookContext, originalReturn)));
+        }
+
+        // Ensure that the stack isn't unbalanced (only the preserved registers and arguments should remain).
+        // This is checked before they are restored, since the hook context in EBX may be needed for reporting.
+        mAssembler->lea(ecx, dword_ptr(ebp, -3 * static_cast<int>(sizeof(uintptr_t)) - (mHasArgumentBlock ? static_cast<int>(mArgumentsSize) : 0)));
+        mAssembler->cmp(esp, ecx);
+        mAssembler->je(returnToCaller);
+        {
+            // If the stack has become displaced, we cannot return execution to the caller. This should
+            // actually never happen, but just in case it does, I have created a check for it. The 'InvalidESP'
+            // member function will be called and report this error and forcefully exit the application.
+            // If this happens, there is (probably) something wrong with the assembly code, or a user callback
+            // that has specified a wrong calling convention which results in an invalid ESP value.
+            this->LoadFunctionBase();
             mAssembler->mov(eax, dword_ptr(ecx));
-            mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::OnExit)));
-
-            if(mConventionInfo.GetReturn().GetType() != DataType::Void) {
-                // If it is a hidden return, we just need to return the pointer
-                mAssembler->mov(ecx, dword_ptr(returnData));
-          
-                if(mHasNonHiddenReturn == true) {
-                    // Otherwise we need to copy the data to the appropriate register
-                    this->SetReturn(mConventionInfo.GetReturn(), ptr(ecx));
+            mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::InvalidESP)));
+        }
+        mAssembler->bind(returnToCaller);
+
+        if(mHasArgumentBlock) {
+            mAssembler->add(esp, mArgumentsSize);
+        }
+
+        if(returnType.GetType() != DataType::Void && mConventionInfo.GetReturnLocation() != Location::EAX) {
+            mAssembler->mov(GetRegister(mConventionInfo.GetReturnLocation()), eax);
+        }
+
+        size_t stackSize = 0;
+
+        if(mConventionInfo.IsCalleClean()) {
+            // We can't use 'ConventionInfo::GetStackSize', because it accounts for the (possible) hidden return parameter
+            for(size_t i = 0; i < mConventionInfo.GetParameters().size(); i++) {
+                if(mConventionInfo.GetParameterLocation(i) == Location::Stack) {
+                    stackSize += mConventionInfo.GetParameters()[i].GetStackSize();
                 }
             }
+        }
+
+        if(mConventionInfo.GetReturnMethod() == ReturnMethod::Hidden) {
+            // On GCC, the callee cleans the hidden parameter
+            stackSize += sizeof(uintptr_t);
+        }
 
-            if(mConventionInfo.IsCalleClean()) {
-                size_t stackSize = 0;
+        // The handler may be released as soon as the epoch is left, so the preserved registers are restored
+        // (and the caller is returned to) by a stub that is never released.
+        mAssembler->jmp(reinterpret_cast<Ptr>(GetExitStub(stackSize, false)));
+    }
 
-                // We can't use 'ConventionInfo::GetStackSize', because it accounts for the (possible) hidden return parameter that we popped earlier
-                for(const DataType& parameter : mConventionInfo.GetParameters()) {
-                    stackSize += parameter.GetStackSize();
-                }
+    void CodeGenerator::GenerateTailCall() {
+        // Retrieve the address of the original function to ESI, since it must survive the call to 'OnExit'
+        this->LoadFunctionBase();
+        mAssembler->mov(eax, dword_ptr(ecx));
+        mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::GetCallableAddress)));
+        mAssembler->mov(esi, eax);
 
-                // We need to clean up the stack space ourself
-                mAssembler->add(esp, stackSize);
-            }
+        // The hook context can still be read after 'OnExit' (see 'GenerateHandlerEpilogue')
+        this->LoadFunctionBase();
+        mAssembler->mov(eax, dword_ptr(ecx));
+        mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::OnExit)));
+
+        if(mConventionInfo.IsMethod()) {
+            // The object instance was saved by the prologue, since ECX did not survive the module calls
+            mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, calleeContext)));
+        }
+
+        // Only EAX is free at this point, since ECX and EDX may contain parameters
+        mAssembler->mov(eax, esi);
+
+        // Restore the caller's frame exactly as it was when the function was called, then let the
+        // original function use the caller's arguments and return directly to the caller.
+        mAssembler->lea(esp, ptr(ebp, -3 * static_cast<int>(sizeof(uintptr_t))));
+        mAssembler->jmp(reinterpret_cast<Ptr>(GetExitStub(0, true)));
+    }
 
-            // Return to the calling address
-            mAssembler->jmp(dword_ptr(callerAddress));
+    void* CodeGenerator::GetExitStub(size_t stackSize, bool tailCall) {
+        std::lock_guard<std::mutex> lock(gExitStubMutex);
+        void*& stub = gExitStubs[std::make_pair(stackSize, tailCall)];
 
-            // ------------------------------------------------------
+        if(stub != nullptr) {
+            return stub;
+        }
 
-            // ... and append the '.data' section
-            mAssembler->bind(callerAddress);
-            mAssembler->dptr(nullptr);
+        CodeGenerator generator((ConventionInfo()));
+        Assembler* assembler = generator.mAssembler.get();
+        Label nested = assembler->newLabel();
+
+        // This is 'Epoch::Exit' for the record stored by 'OnDispatch' (EBX is the hook context). The
+        // record is cleared with two stores, but a reader never sees a later epoch than the real one.
+        assembler->push(eax);
+        assembler->mov(eax, dword_ptr(ebx, offsetof(HookContext, epochRecord)));
+        assembler->dec(dword_ptr(eax, offsetof(Epoch::ThreadRecord, depth)));
+        assembler->jnz(nested);
+        assembler->mov(dword_ptr(eax, offsetof(Epoch::ThreadRecord, epoch)), 0);
+        assembler->mov(dword_ptr(eax, offsetof(Epoch::ThreadRecord, epoch) + 4), 0);
+        assembler->bind(nested);
+        assembler->pop(eax);
+
+        // Reset preserved registers
+        assembler->pop(edi);
+        assembler->pop(esi);
+        assembler->pop(ebx);
+        assembler->pop(ebp);
+
+        if(tailCall) {
+            assembler->jmp(eax);
+        } else if(stackSize > 0) {
+            // Return to the calling address (and clean up the stack space ourself, if required)
+            assembler->ret(stackSize);
+        } else {
+            assembler->ret();
+        }
+
+        stub = generator.MakePermanentCode();
+        return stub;
+    }
+
+    void CodeGenerator::SetLocality(const void* address) {
+        mLocality = address;
+    }
+
+    void CodeGenerator::SetMemoized(bool memoized) {
+        mMemoized = memoized;
+    }
+
+    void CodeGenerator::SetAsyncCapture(bool capture) {
+        mAsyncCapture = capture;
+    }
+
+    std::shared_ptr<void> CodeGenerator::MakeCode() {
+        CodeArena& arena = CodeArena::GetGlobal();
+
+        // The code is placed in our own arena (near the hooked function) instead of asmjit's memory
+        void* code = arena.Allocate(mAssembler->getCodeSize(), mLocality);
+        mAssembler->relocCode(code, reinterpret_cast<Ptr>(code));
+
+        return std::shared_ptr<void>(code, [&arena](void* code) { arena.Release(code); });
+    }
+
+    void* CodeGenerator::MakePermanentCode() {
+        void* code = CodeArena::GetGlobal().Allocate(mAssembler->getCodeSize(), mLocality);
+        mAssembler->relocCode(code, reinterpret_cast<Ptr>(code));
+
+        return code;
+    }
+
+    void CodeGenerator::LoadFunctionBase() {
+        if(mFunctionBase != nullptr) {
+            mAssembler->mov(ecx, reinterpret_cast<uintptr_t>(mFunctionBase));
+        } else {
+            // Shared code serves several functions, so it is read from the hook context
+            mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, function)));
+        }
+    }
+
+    void CodeGenerator::CallOriginal() {
+        if(mConventionInfo.IsVariadic()) {
+            // The size of the variadic arguments is unknown, so they cannot be copied
+            this->CallOriginalInPlace();
+            return;
+        }
 
-            if(mConventionInfo.GetReturn().GetType() != DataType::Void) {
-                mAssembler->bind(returnData);
-                mAssembler->dptr(nullptr);
+        const std::vector<DataType>& parameters = mConventionInfo.GetParameters();
+
+        for(size_t i = parameters.size(); i-- > 0;) {
+            // Push each stack parameter (in reverse order) from the handler's copy of the arguments
+            if(mConventionInfo.GetParameterLocation(i) == Location::Stack) {
+                this->PushParameter(parameters[i], this->GetParameterSource(i));
             }
+        }
 
-            if(mConventionInfo.IsMethod()) {
-                mAssembler->bind(calleeContext);
-                mAssembler->dptr(nullptr);
+        // Call 'IFunctionBase::GetCallableAddress' to retrieve the address that we should use
+        // for calling the original function. The result will be stored in EAX for later usage.
+        this->LoadFunctionBase();
+        mAssembler->mov(eax, dword_ptr(ecx));
+        mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::GetCallableAddress)));
+
+        if(mConventionInfo.IsMethod()) {
+            // If it is a method, we need to supply the context
+            mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, calleeContext)));
+        }
+
+        if(mConventionInfo.GetReturnMethod() == ReturnMethod::Hidden) {
+            // In case the return value is hidden, push the result data address
+            mAssembler->push(dword_ptr(ebx, offsetof(HookContext, originalReturn)));
+        }
+
+        // The address is moved to ESI (it is preserved) if EAX is needed for a parameter
+        bool addressInEsi = mConventionInfo.UsesRegister(Location::EAX);
+
+        if(addressInEsi) {
+            mAssembler->mov(esi, eax);
+        }
+
+        for(size_t i = 0; i < parameters.size(); i++) {
+            Location location = mConventionInfo.GetParameterLocation(i);
+
+            if(location != Location::Stack) {
+                this->LoadParameter(parameters[i], location, this->GetParameterSource(i));
             }
+        }
+
+        // Call the original function!
+        mAssembler->call(addressInEsi ? esi : eax);
 
-            mHookHandler.reset(mAssembler->make(), [](void* code) { MemoryManager::getGlobal()->release(code); });
+        if(!mConventionInfo.IsCalleClean()) {
+            // We need to clean up the stack after us
+            mAssembler->add(esp, mConventionInfo.GetStackSize());
         }
 
-        return mHookHandler.get();
+        if(mHasNonHiddenReturn && mConventionInfo.GetReturnLocation() != Location::EAX) {
+            // The rest of the handler expects the return value in EAX
+            mAssembler->mov(eax, GetRegister(mConventionInfo.GetReturnLocation()));
+        }
+    }
+
+    void CodeGenerator::CallOriginalInPlace() {
+        Label returned = mAssembler->newLabel();
+
+        // The register slots of the frame (EBP, EBX, ESI and EDI) will be overwritten by the
+        // original function, so the caller's values are stored in the hook context meanwhile.
+        for(size_t i = 0; i < HookContext::CallerRegisterCount; i++) {
+            mAssembler->mov(ecx, dword_ptr(ebp, -static_cast<int>(i * sizeof(uintptr_t))));
+            mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, callerRegisters) + i * sizeof(uintptr_t)), ecx);
+        }
+
+        // Retrieve the address of the original function to EAX
+        this->LoadFunctionBase();
+        mAssembler->mov(eax, dword_ptr(ecx));
+        mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::GetCallableAddress)));
+
+        // The original function returns to us instead of the caller
+        mAssembler->lea(ecx, ptr(returned));
+        mAssembler->mov(dword_ptr(ebp, 4), ecx);
+
+        // Make the stack look exactly as it did when the function was called and jump to it. The
+        // handler's frame is kept in ESI (and the hook context in EBX), since they are preserved.
+        mAssembler->mov(esi, ebp);
+        mAssembler->lea(esp, ptr(ebp, 4));
+        mAssembler->mov(ebp, dword_ptr(ebp));
+        mAssembler->jmp(eax);
+
+        // ------------------------------------------------------
+
+        // The return value is in EAX, EDX or ST(0), so only ECX may be used from here on
+        mAssembler->bind(returned);
+        mAssembler->mov(ebp, esi);
+        mAssembler->lea(esp, ptr(ebp, -3 * static_cast<int>(sizeof(uintptr_t))));
+
+        for(size_t i = 0; i < HookContext::CallerRegisterCount; i++) {
+            mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, callerRegisters) + i * sizeof(uintptr_t)));
+            mAssembler->mov(dword_ptr(ebp, -static_cast<int>(i * sizeof(uintptr_t))), ecx);
+        }
+
+        // Restore the caller's return address
+        mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, callerAddress)));
+        mAssembler->mov(dword_ptr(ebp, 4), ecx);
     }
 
     void CodeGenerator::CallModules(Tense::Type tense) {
         // Define all labels that we are utilizing
         Label iterateModule  = mAssembler->newLabel();
-        Label skipHighResult = mAssembler->newLabel();
         Label endCallModule  = mAssembler->newLabel();
 
         // Update the hook context with the current tense
         mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, tense)), tense);
 
         // Call 'ResetIterator' (required since we call both Pre & Post)
-        mAssembler->mov(ecx, reinterpret_cast<uintptr_t>(mFunctionBase));
+        this->LoadFunctionBase();
         mAssembler->mov(eax, dword_ptr(ecx));
         mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::ResetIterator)));
 
         // Copy 'IFunctionBase' to ECX and call 'IterateModule'
         mAssembler->bind(iterateModule);
-        mAssembler->mov(ecx, reinterpret_cast<uintptr_t>(mFunctionBase));
+        this->LoadFunctionBase();
         mAssembler->mov(eax, dword_ptr(ecx));
         mAssembler->call(dword_ptr(eax, VTableOffset<IFunctionBase>(&IFunctionBase::IterateModule)));
 
@@ -360,21 +858,208 @@ namespace gm {
             mAssembler->cmp(al, false);
             mAssembler->je(iterateModule);
 
-            size_t stackDisplacement = mLastArgument;
+            this->CallModule(iterateModule);
+        }
+        mAssembler->jmp(iterateModule);
+        mAssembler->bind(endCallModule);
+    }
+
+    void CodeGenerator::CallModules(Tense::Type tense, const std::vector<ModuleFunction*>& modules) {
+        // Update the hook context with the current tense
+        mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, tense)), tense);
+
+        for(ModuleFunction* module : modules) {
+            Label nextModule = mAssembler->newLabel();
+
+            // Calls the module is not interested in only cost a few comparisons
+            this->GenerateModuleFilter(module, nextModule, tense);
+
+            // The modules have already been filtered, so there is no need to call 'IsCallable'
+            mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, module)), reinterpret_cast<uintptr_t>(module));
+
+            this->CallModule(nextModule, module);
+            mAssembler->bind(nextModule);
+        }
+    }
+
+    void CodeGenerator::GenerateModuleFilter(ModuleFunction* module, const Label& skip, Tense::Type tense) {
+        const std::vector<CallerRange>& ranges = module->GetCallerRanges();
+
+        if(!ranges.empty()) {
+            Label accepted = mAssembler->newLabel();
+
+            // The ranges are embedded, so they are never read from the module
+            mAssembler->mov(eax, dword_ptr(ebx, offsetof(HookContext, callerAddress)));
+
+            for(const CallerRange& range : ranges) {
+                Label nextRange = mAssembler->newLabel();
 
-            for(const DataType& parameter : boost::adaptors::reverse(mConventionInfo.GetParameters())) {
-                // Push each function parameter to the target module, and add the EBP offset (first argument at [EBP + 4])
-                stackDisplacement -= this->PushParameter(parameter, ptr(ebp, stackDisplacement));
+                mAssembler->cmp(eax, range.begin);
+                mAssembler->jb(nextRange);
+                mAssembler->cmp(eax, range.end);
+                mAssembler->jb(accepted);
+                mAssembler->bind(nextRange);
             }
 
-            // The last argument is the hook context
-            mAssembler->push(ebx);
+            mAssembler->jmp(skip);
+            mAssembler->bind(accepted);
+        }
 
-            if(mConventionInfo.GetReturnMethod() == ReturnMethod::Hidden) {
-                // In case the return value is hidden, push the result data address
-                mAssembler->push(dword_ptr(ebx, offsetof(HookContext, currentReturn)));
+        for(const ArgPredicate& predicate : module->GetPredicates()) {
+            const DataType& type = mConventionInfo.GetParameters()[predicate.parameter];
+            Mem source = this->GetParameterSource(predicate.parameter);
+
+            // The argument is extended the same way as the values were normalized (see 'ModuleFunction::AddPredicate')
+            source.setSize(type.GetSize());
+
+            if(type.GetSize() == sizeof(uint)) {
+                mAssembler->mov(eax, source);
+            } else if(predicate.type == Predicate::SignedRange) {
+                mAssembler->movsx(eax, source);
+            } else {
+                mAssembler->movzx(eax, source);
             }
 
+            switch(predicate.type) {
+                case Predicate::Equal:
+                    mAssembler->cmp(eax, predicate.values[0]);
+                    mAssembler->jne(skip);
+                    break;
+
+                case Predicate::NotEqual:
+                    mAssembler->cmp(eax, predicate.values[0]);
+                    mAssembler->je(skip);
+                    break;
+
+                case Predicate::AnyBits:
+                    mAssembler->test(eax, predicate.values[0]);
+                    mAssembler->jz(skip);
+                    break;
+
+                case Predicate::NoBits:
+                    mAssembler->test(eax, predicate.values[0]);
+                    mAssembler->jnz(skip);
+                    break;
+
+                case Predicate::Range:
+                    mAssembler->cmp(eax, predicate.values[0]);
+                    mAssembler->jb(skip);
+                    mAssembler->cmp(eax, predicate.values[1]);
+                    mAssembler->ja(skip);
+                    break;
+
+                case Predicate::SignedRange:
+                    mAssembler->cmp(eax, predicate.values[0]);
+                    mAssembler->jl(skip);
+                    mAssembler->cmp(eax, predicate.values[1]);
+                    mAssembler->jg(skip);
+                    break;
+
+                case Predicate::OneOf: {
+                    Label matched = mAssembler->newLabel();
+
+                    for(size_t i = 0; i < predicate.count; i++) {
+                        mAssembler->cmp(eax, predicate.values[i]);
+                        mAssembler->je(matched);
+                    }
+
+                    mAssembler->jmp(skip);
+                    mAssembler->bind(matched);
+                    break;
+                }
+            }
+        }
+
+        // The sampler is advanced last, so it only counts the calls that the listener is interested in
+        this->GenerateSampleTest(module, skip, tense);
+    }
+
+    void CodeGenerator::GenerateSampleTest(ModuleFunction* module, const Label& skip, Tense::Type tense) {
+        Sampler* sampler = module->GetSampler();
+
+        if(!sampler->IsEnabled()) {
+            return;
+        }
+
+        auto pair = std::find(mSampledPairs.begin(), mSampledPairs.end(), module);
+        uint pairBit = (pair != mSampledPairs.end()) ? (1u << (pair - mSampledPairs.begin())) : 0;
+
+        if(pairBit != 0 && tense == Tense::Post) {
+            // The decision was made in pre, so the same calls are seen in both tenses
+            mAssembler->test(dword_ptr(ebx, offsetof(HookContext, sampled)), pairBit);
+            mAssembler->jz(skip);
+            return;
+        }
+
+        if(sampler->interval > 1) {
+            // The sampler is updated in place, so the settings are embedded and only the countdown is read. Any
+            // number of threads may count at once, so only the one that takes it to zero samples the call and
+            // resets it; the others see it non-zero (negative, if it was not reset yet) and count towards the
+            // next interval, since the reset adds to it instead of overwriting it (see 'Sampler::Sample').
+            mAssembler->lock();
+            mAssembler->dec(dword_ptr_abs(reinterpret_cast<Ptr>(&sampler->countdown)));
+            mAssembler->jnz(skip);
+            mAssembler->lock();
+            mAssembler->add(dword_ptr_abs(reinterpret_cast<Ptr>(&sampler->countdown)), sampler->interval);
+        } else {
+            // Advance the xorshift state (see 'Sampler::Sample')
+            mAssembler->mov(eax, dword_ptr_abs(reinterpret_cast<Ptr>(&sampler->state)));
+            mAssembler->mov(edx, eax);
+            mAssembler->shl(edx, 13);
+            mAssembler->xor_(eax, edx);
+            mAssembler->mov(edx, eax);
+            mAssembler->shr(edx, 17);
+            mAssembler->xor_(eax, edx);
+            mAssembler->mov(edx, eax);
+            mAssembler->shl(edx, 5);
+            mAssembler->xor_(eax, edx);
+            mAssembler->mov(dword_ptr_abs(reinterpret_cast<Ptr>(&sampler->state)), eax);
+            mAssembler->cmp(eax, sampler->threshold);
+            mAssembler->jae(skip);
+        }
+
+        if(pairBit != 0) {
+            mAssembler->or_(dword_ptr(ebx, offsetof(HookContext, sampled)), pairBit);
+        }
+    }
+
+    void CodeGenerator::CallModule(const Label& next, IModuleFunction* module) {
+        Label skipHighResult = mAssembler->newLabel();
+
+        if(module != nullptr) {
+            this->PushModuleArguments(module->IsFrameListener());
+        } else /* Ask the module how it wants them */ {
+            Label frameListener = mAssembler->newLabel();
+            Label pushed = mAssembler->newLabel();
+
+            mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, module)));
+            mAssembler->mov(eax, dword_ptr(ecx));
+            mAssembler->call(dword_ptr(eax, VTableOffset<IModuleFunction>(&IModuleFunction::IsFrameListener)));
+            mAssembler->cmp(al, false);
+            mAssembler->jne(frameListener);
+
+            this->PushModuleArguments(false);
+            mAssembler->jmp(pushed);
+
+            mAssembler->bind(frameListener);
+            this->PushModuleArguments(true);
+            mAssembler->bind(pushed);
+        }
+
+        // The last argument is the hook context
+        mAssembler->push(ebx);
+
+        if(mConventionInfo.GetReturnMethod() == ReturnMethod::Hidden) {
+            // In case the return value is hidden, push the result data address
+            mAssembler->push(dword_ptr(ebx, offsetof(HookContext, currentReturn)));
+        }
+
+        if(module != nullptr) {
+            // Both the callback and its context are known, so we call it directly
+            mAssembler->mov(ecx, reinterpret_cast<uintptr_t>(module->GetContext()));
+            mAssembler->mov(eax, reinterpret_cast<uintptr_t>(module->GetCallback()));
+            mAssembler->call(eax);
+        } else /* Retrieve them from the module */ {
             // Call the module function with the associated context
             mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, module)));
             mAssembler->mov(edx, dword_ptr(ecx));
@@ -384,47 +1069,101 @@ namespace gm {
             mAssembler->mov(ecx, eax);
             mAssembler->pop(eax);
             mAssembler->call(eax);
+        }
 
-            // Assign the current module result to the 'previous' result
-            mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, currentResult)));
-            mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, currentResult)), static_cast<int>(Result::Unset));
-
-            // Replace 'previous' result with the current module function result
-            mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, previousResult)), ecx);
+        // Assign the current module result to the 'previous' result
+        mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, currentResult)));
+        mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, currentResult)), static_cast<int>(Result::Unset));
+
+        // Replace 'previous' result with the current module function result
+        mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, previousResult)), ecx);
+
+        // Check if we need to replace the highest result with the one returned
+        mAssembler->cmp(ecx, dword_ptr(ebx, offsetof(HookContext, highestResult)));
+        mAssembler->jbe(skipHighResult);
+        mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, highestResult)), ecx);
+        mAssembler->bind(skipHighResult);
+
+        if(mHasNonHiddenReturn == true) {
+            // We need to retrieve the return value so we can replace the original return value
+            // if necessary. Although we handle the return value of all functions, because floating point
+            // return values demand that they are popped from the floating point stack.
+            mAssembler->push(ecx);
+            mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, currentReturn)));
+            this->SaveReturn(mConventionInfo.GetReturn(), ptr(ecx));
+            mAssembler->pop(ecx);
+        }
 
-            // Check if we need to replace the highest result with the one returned
+        if(mConventionInfo.GetReturn().GetType() != DataType::Void) {
+            // Check if the module function should override the original return value
+            mAssembler->cmp(ecx, static_cast<int>(Result::Override));
+            mAssembler->jb(next);
             mAssembler->cmp(ecx, dword_ptr(ebx, offsetof(HookContext, highestResult)));
-            mAssembler->jbe(skipHighResult);
-            mAssembler->mov(dword_ptr(ebx, offsetof(HookContext, highestResult)), ecx);
-            mAssembler->bind(skipHighResult);
+            mAssembler->jb(next);
 
-            if(mHasNonHiddenReturn == true) {
-                // We need to retrieve the return value so we can replace the original return value
-                // if necessary. Although we handle the return value of all functions, because floating point
-                // return values demand that they are popped from the floating point stack.
-                mAssembler->push(ecx);
-                mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, currentReturn)));
-                this->SaveReturn(mConventionInfo.GetReturn(), ptr(ecx));
-                mAssembler->pop(ecx);
-            }
+            // We need to dereference the addresses twice, so we move them to EAX:EDX first
+            mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, currentReturn)));
+            mAssembler->mov(edx, dword_ptr(ebx, offsetof(HookContext, overrideReturn)));
 
-            if(mConventionInfo.GetReturn().GetType() != DataType::Void) {
-                // Check if the module function should override the original return value
-                mAssembler->cmp(ecx, static_cast<int>(Result::Override));
-                mAssembler->jb(iterateModule);
-                mAssembler->cmp(ecx, dword_ptr(ebx, offsetof(HookContext, highestResult)));
-                mAssembler->jb(iterateModule);
+            // Then we copy data data between the source to the destination
+            this->CopyData(mConventionInfo.GetReturn(), ptr(ecx), ptr(edx));
+        }
+    }
 
-                // We need to dereference the addresses twice, so we move them to EAX:EDX first
-                mAssembler->mov(ecx, dword_ptr(ebx, offsetof(HookContext, currentReturn)));
-                mAssembler->mov(edx, dword_ptr(ebx, offsetof(HookContext, overrideReturn)));
+    void CodeGenerator::PushModuleArguments(bool frameListener) {
+        const std::vector<DataType>& parameters = mConventionInfo.GetParameters();
 
-                // Then we copy data data between the source to the destination
-                this->CopyData(mConventionInfo.GetReturn(), ptr(ecx), ptr(edx));
+        if(frameListener) {
+            // The arguments are already laid out as a frame, so only their address is passed
+            if(parameters.empty()) {
+                mAssembler->push(0);
+            } else {
+                mAssembler->push(dword_ptr(ebx, offsetof(HookContext, arguments)));
             }
+
+            return;
+        }
+
+        if(mConventionInfo.IsVariadic()) {
+            // The variadic arguments follow the last parameter, and they are passed as a 'va_list'
+            mAssembler->lea(eax, ptr(ebp, mArgumentBase + mArgumentsSize));
+            mAssembler->push(eax);
+        }
+
+        for(size_t i = parameters.size(); i-- > 0;) {
+            // Modules receive every parameter on the stack, wherever the function was passed it
+            this->PushParameter(parameters[i], this->GetParameterSource(i));
+        }
+    }
+
+    Mem CodeGenerator::GetParameterSource(size_t index) const {
+        const DataType& parameter = mConventionInfo.GetParameters()[index];
+        int offset = mArgumentBase + static_cast<int>(mConventionInfo.GetParameterOffset(index) + parameter.GetStackSize() - sizeof(uintptr_t));
+
+        return ptr(ebp, offset);
+    }
+
+    const GpReg& CodeGenerator::GetRegister(Location location) {
+        switch(location) {
+            default: assert(false);
+            case Location::EAX: return eax;
+            case Location::ECX: return ecx;
+            case Location::EDX: return edx;
+        }
+    }
+
+    void CodeGenerator::LoadParameter(const DataType& type, Location location, Mem source) {
+        const GpReg& reg = GetRegister(location);
+        size_t typeSize = type.GetSize();
+
+        // Only integers and pointers that fit in a register are passed in one (see 'ConventionInfo')
+        source.setSize(typeSize);
+
+        if(typeSize < sizeof(uint)) {
+            mAssembler->movzx(reg, source);
+        } else {
+            mAssembler->mov(reg, source);
         }
-        mAssembler->jmp(iterateModule);
-        mAssembler->bind(endCallModule);
     }
 
     // This method may only touch the ECX, ESI and/or EDI registers
@@ -2,10 +2,14 @@
 
 #include <GoldMeta/Gold/IModuleFunction.hpp>
 #include <asmjit/asmjit.h>
+#include <functional>
 #include <memory>
+#include <vector>
+#include <atomic>
 
 #include "DataType.hpp"
 #include "ConventionInfo.hpp"
+#include "ModuleFunction.hpp"
 #include "../Interface/IFunctionBase.hpp"
 #include "../OS/OS.hpp"
 
@@ -13,7 +17,7 @@ namespace gm {
     /// <summary>
     /// The type of a 'call hook' function pointer
     /// </summary>
-    typedef void(STDCALL *FNCallHook)(void*, const void*[]);
+    typedef void(STDCALL *FNCallHook)(void*, void*, const void*[]);
 
     class CodeGenerator {
     public:
@@ -23,21 +27,174 @@ namespace gm {
         CodeGenerator(IFunctionBase* function);
 
         /// <summary>
-        /// Generates the assembly for a call hook
+        /// Constructs a hook generator for code that is shared by all functions with the same convention info
+        /// </summary>
+        CodeGenerator(const ConventionInfo& cInfo);
+
+        /// <summary>
+        /// Gets the (shared) call hook, which calls the address it is given with the supplied arguments
         /// </summary>
         FNCallHook GenerateCallHook();
 
         /// <summary>
-        /// Generates the assembly for the hook handler
+        /// Gets the (shared) hook handler, which must be entered through the entry stub
         /// </summary>
         void* GenerateHookHandler();
 
+        /// <summary>
+        /// Sets the address that generated code should be placed close to
+        /// </summary>
+        void SetLocality(const void* address);
+
+        /// <summary>
+        /// Sets whether specialized handlers look up (and store) the result in the function's cache
+        /// </summary>
+        void SetMemoized(bool memoized);
+
+        /// <summary>
+        /// Sets whether specialized handlers pass each completed call to the function's asynchronous listeners
+        /// </summary>
+        void SetAsyncCapture(bool capture);
+
+        /// <summary>
+        /// Emits a new call hook (use 'CodeCache' to share it)
+        /// </summary>
+        std::shared_ptr<void> EmitCallHook();
+
+        /// <summary>
+        /// Emits a new generic hook handler (use 'CodeCache' to share it)
+        /// </summary>
+        std::shared_ptr<void> EmitHookHandler();
+
+        /// <summary>
+        /// Generates a hook handler with each module's callback and context hard-coded
+        /// </summary>
+        std::shared_ptr<void> GenerateSpecializedHandler(const std::vector<ModuleFunction*>& pre, const std::vector<ModuleFunction*>& post);
+
+        /// <summary>
+        /// Generates the assembly for a stub that jumps to the handler stored at the target
+        /// </summary>
+        void* GenerateDispatcher(std::atomic<void*>* target);
+
+        /// <summary>
+        /// Generates the assembly for a stub that asks the function which handler to enter
+        /// </summary>
+        void* GenerateEntryStub();
+
+        /// <summary>
+        /// Generates a mid-function handler, which calls 'callback(object, Registers*)' (cdecl)
+        /// with a register snapshot and then continues at the resume address (it is never released)
+        /// </summary>
+        void* GenerateMidHandler(void* object, void* callback, const void* resume);
+
     private:
+        /// <summary>
+        /// The size of the area that 'fxsave' stores the FPU and SSE state in (it must be aligned to 16 bytes)
+        /// </summary>
+        static const size_t FxStateSize = 512;
+
+        /// <summary>
+        /// Generates the common hook handler body, calling modules with the specified generator
+        /// </summary>
+        void GenerateHandlerBody(const std::function<void(Tense::Type)>& callModules);
+
+        /// <summary>
+        /// Generates a hook handler body without a post path (the return value is passed through)
+        /// </summary>
+        void GeneratePreHandlerBody(const std::vector<ModuleFunction*>& pre);
+
+        /// <summary>
+        /// Generates the hook handler entry, retrieving the hook context into EBX
+        /// </summary>
+        void GenerateHandlerPrologue();
+
+        /// <summary>
+        /// Generates the hook handler exit (optionally keeping the return value in its registers)
+        /// </summary>
+        void GenerateHandlerEpilogue(bool keepReturn);
+
+        /// <summary>
+        /// Generates the hook handler exit that restores the caller's frame and jumps to the original function
+        /// </summary>
+        void GenerateTailCall();
+
+        /// <summary>
+        /// Copies the assembled code to executable memory
+        /// </summary>
+        std::shared_ptr<void> MakeCode();
+
+        /// <summary>
+        /// Copies the assembled code to executable memory that is never released
+        /// </summary>
+        void* MakePermanentCode();
+
+        /// <summary>
+        /// Gets the stub that handlers exit through, which leaves the epoch entered by 'OnDispatch', restores
+        /// the preserved registers and returns (or jumps to EAX if it is a tail call). It is never released,
+        /// since a thread is no longer protected by the epoch once it has left it.
+        /// </summary>
+        static void* GetExitStub(size_t stackSize, bool tailCall);
+
+        /// <summary>
+        /// Generates assembly for loading the function into ECX (from the hook context, if the code is shared)
+        /// </summary>
+        void LoadFunctionBase();
+
+        /// <summary>
+        /// Generates assembly for calling the original function with the hooked arguments
+        /// </summary>
+        void CallOriginal();
+
+        /// <summary>
+        /// Generates assembly for calling the original function within the caller's frame (used for variadic functions)
+        /// </summary>
+        void CallOriginalInPlace();
+
         /// <summary>
         /// Generates assembly for calling all plugins
         /// </summary>
         void CallModules(Tense::Type tense);
 
+        /// <summary>
+        /// Generates assembly for calling a fixed set of plugins
+        /// </summary>
+        void CallModules(Tense::Type tense, const std::vector<ModuleFunction*>& modules);
+
+        /// <summary>
+        /// Generates assembly for calling one module (it is looked up at runtime if not specified)
+        /// </summary>
+        void CallModule(const asmjit::Label& next, IModuleFunction* module = nullptr);
+
+        /// <summary>
+        /// Generates the caller, argument and sampling tests of a module, which jump to 'skip' if any fails
+        /// </summary>
+        void GenerateModuleFilter(ModuleFunction* module, const asmjit::Label& skip, Tense::Type tense);
+
+        /// <summary>
+        /// Generates the sampling test of a module, which jumps to 'skip' if the call is not sampled
+        /// </summary>
+        void GenerateSampleTest(ModuleFunction* module, const asmjit::Label& skip, Tense::Type tense);
+
+        /// <summary>
+        /// Pushes the arguments for a module, either copied or as a pointer to the argument frame
+        /// </summary>
+        void PushModuleArguments(bool frameListener);
+
+        /// <summary>
+        /// Gets the handler's copy of a parameter (the displacement points at its last double word)
+        /// </summary>
+        asmjit::host::Mem GetParameterSource(size_t index) const;
+
+        /// <summary>
+        /// Gets the general purpose register that represents a location
+        /// </summary>
+        static const asmjit::host::GpReg& GetRegister(Location location);
+
+        /// <summary>
+        /// Loads a parameter that is passed in a register from the specified source
+        /// </summary>
+        void LoadParameter(const DataType& type, Location location, asmjit::host::Mem source);
+
         /// <summary>
         /// Pushes a parameter on the stack from a specified source
         /// </summary>
@@ -65,12 +222,20 @@ namespace gm {
 
         // Private members
         IFunctionBase* mFunctionBase;
+        const void* mLocality;
         ConventionInfo mConventionInfo;
         asmjit::JitRuntime mJitRuntime;
         std::unique_ptr<asmjit::host::Assembler> mAssembler;
         std::shared_ptr<void> mHookHandler;
+        std::shared_ptr<void> mDispatcher;
+        std::shared_ptr<void> mEntryStub;
         std::shared_ptr<void> mCallHook;
         bool mHasNonHiddenReturn;
-        size_t mLastArgument;
+        bool mHasArgumentBlock;
+        bool mMemoized;
+        bool mAsyncCapture;
+        std::vector<ModuleFunction*> mSampledPairs;
+        size_t mArgumentsSize;
+        int mArgumentBase;
     };
 }
@@ -1,19 +1,98 @@
+#include <algorithm>
 #include <cassert>
+#include <tuple>
 
 #include "ConventionInfo.hpp"
 
+namespace /* Anonymous */ {
+    bool FitsRegister(const gm::DataType& type) {
+        // Larger integers would be split across registers, which no supported convention does
+        return (type.GetType() == gm::DataType::Integral || type.GetType() == gm::DataType::Pointer) && type.GetSize() <= sizeof(uint);
+    }
+}
+
 namespace gm {
     ConventionInfo::ConventionInfo() :
-        mConvention(CallingConvention::CDecl)
+        mConvention(CallingConvention::CDecl),
+        mReturnLocation(Location::EAX),
+        mVariadic(false)
     {
     }
 
-    ConventionInfo::ConventionInfo(CallingConvention cc, DataType returnType, std::vector<DataType> parameterTypes) :
+    ConventionInfo::ConventionInfo(CallingConvention cc, DataType returnType, std::vector<DataType> parameterTypes, bool variadic) :
         mParameters(parameterTypes),
         mReturn(returnType),
-        mConvention(cc)
+        mConvention(cc),
+        mReturnLocation(Location::EAX),
+        mVariadic(variadic)
     {
+        // Only the caller knows the size of the variadic arguments, so it must clean the stack
+        assert(!variadic || cc == CallingConvention::CDecl);
+        this->AssignLocations(std::vector<Location>(), Location::Default);
+    }
 
+    ConventionInfo::ConventionInfo(CallingConvention cc, DataType returnType, std::vector<DataType> parameterTypes, std::vector<Location> locations, Location returnLocation) :
+        mParameters(parameterTypes),
+        mReturn(returnType),
+        mConvention(cc),
+        mReturnLocation(Location::EAX),
+        mVariadic(false)
+    {
+        this->AssignLocations(locations, returnLocation);
+    }
+
+    ConventionInfo ConventionInfo::FromSignature(const Signature& signature) {
+        static_assert(static_cast<int>(Convention::CDecl) == static_cast<int>(CallingConvention::CDecl), "The convention enumerations must match");
+        std::vector<DataType> parameters;
+        DataType returnType;
+
+        try {
+            for(unsigned int i = 0; i < signature.parameterCount; i++) {
+                parameters.push_back(DataType::FromDescriptor(signature.parameters[i]));
+
+                if(parameters.back().GetType() == DataType::Void) {
+                    throw Exception(format("parameter %d is void") % i);
+                }
+            }
+
+            returnType = DataType::FromDescriptor(signature.returnType);
+        } catch(const DataType::Exception& ex) {
+            throw Exception(ex.what());
+        }
+
+        // Small structures are returned in registers, larger ones through a hidden parameter, but
+        // compilers do not agree on the sizes in between (see 'GetReturnMethod')
+        if(returnType.GetType() == DataType::Structure && returnType.GetSize() < sizeof(uint64) && returnType.GetSize() != sizeof(byte) &&
+            returnType.GetSize() != sizeof(ushort) && returnType.GetSize() != sizeof(uint)) {
+            throw Exception(format("structures of %d bytes cannot be returned") % returnType.GetSize());
+        }
+
+        if(static_cast<unsigned int>(signature.convention) > static_cast<unsigned int>(Convention::CDecl)) {
+            throw Exception(format("unknown calling convention %d") % static_cast<int>(signature.convention));
+        }
+
+        CallingConvention convention = static_cast<CallingConvention>(signature.convention);
+
+        // Only the caller knows the size of the variadic arguments, so it must clean the stack
+        if(signature.isVariadic && convention != CallingConvention::CDecl) {
+            throw Exception("variadic functions must use the cdecl convention");
+        }
+
+        if(signature.locations == nullptr && signature.returnLocation == Location::Default) {
+            return ConventionInfo(convention, returnType, parameters, signature.isVariadic);
+        }
+
+        if(signature.isVariadic) {
+            throw Exception("variadic functions cannot pass parameters in registers");
+        }
+
+        std::vector<Location> locations;
+
+        if(signature.locations != nullptr) {
+            locations.assign(signature.locations, signature.locations + signature.parameterCount);
+        }
+
+        return ConventionInfo(convention, returnType, parameters, locations, signature.returnLocation);
     }
 
     CallingConvention ConventionInfo::GetConvention() const {
@@ -23,8 +102,10 @@ namespace gm {
     size_t ConventionInfo::GetStackSize() const {
         size_t totalStackSize = 0;
 
-        for(const DataType& parameter : mParameters) {
-            totalStackSize += parameter.GetStackSize();
+        for(size_t i = 0; i < mParameters.size(); i++) {
+            if(mLocations[i] == Location::Stack) {
+                totalStackSize += mParameters[i].GetStackSize();
+            }
         }
 
         // On GCC, the callee cleans the hidden parameter
@@ -39,6 +120,35 @@ namespace gm {
         return mParameters;
     }
 
+    size_t ConventionInfo::GetParameterOffset(size_t index) const {
+        assert(index < mParameters.size());
+        size_t offset = 0;
+
+        // The parameters are pushed from right to left, so the first one is at the lowest address
+        for(size_t i = 0; i < index; i++) {
+            offset += mParameters[i].GetStackSize();
+        }
+
+        return offset;
+    }
+
+    Location ConventionInfo::GetParameterLocation(size_t index) const {
+        assert(index < mLocations.size());
+        return mLocations[index];
+    }
+
+    Location ConventionInfo::GetReturnLocation() const {
+        return mReturnLocation;
+    }
+
+    bool ConventionInfo::HasRegisterParameters() const {
+        return std::any_of(mLocations.begin(), mLocations.end(), [](Location location) { return location != Location::Stack; });
+    }
+
+    bool ConventionInfo::UsesRegister(Location location) const {
+        return std::find(mLocations.begin(), mLocations.end(), location) != mLocations.end();
+    }
+
     const DataType& ConventionInfo::GetReturn() const {
         return mReturn;
     }
@@ -97,4 +207,68 @@ namespace gm {
                 return true;
         }
     }
-}
\ No newline at end of file
+
+    bool ConventionInfo::IsVariadic() const {
+        return mVariadic;
+    }
+
+    bool ConventionInfo::operator<(const ConventionInfo& other) const {
+        return std::tie(mConvention, mReturn, mParameters, mLocations, mReturnLocation, mVariadic) <
+            std::tie(other.mConvention, other.mReturn, other.mParameters, other.mLocations, other.mReturnLocation, other.mVariadic);
+    }
+
+    void ConventionInfo::AssignLocations(const std::vector<Location>& locations, Location returnLocation) {
+        mLocations.assign(mParameters.size(), Location::Stack);
+
+        if(mConvention == CallingConvention::Fastcall) {
+            // The first two parameters that fit are passed in ECX and EDX, the rest on the stack
+            const Location registers[] = { Location::ECX, Location::EDX };
+            size_t assigned = 0;
+
+            for(size_t i = 0; i < mParameters.size() && assigned < GM_ARRAY_SIZE(registers); i++) {
+                if(FitsRegister(mParameters[i])) {
+                    mLocations[i] = registers[assigned++];
+                }
+            }
+        }
+
+        if(!locations.empty()) {
+            if(locations.size() != mParameters.size()) {
+                throw Exception("the number of locations does not match the number of parameters");
+            }
+
+            for(size_t i = 0; i < locations.size(); i++) {
+                if(locations[i] != Location::Default) {
+                    mLocations[i] = locations[i];
+                }
+            }
+        }
+
+        for(size_t i = 0; i < mLocations.size(); i++) {
+            if(mLocations[i] == Location::Stack) {
+                continue;
+            }
+
+            if(!FitsRegister(mParameters[i])) {
+                throw Exception(format("parameter %d cannot be passed in a register") % i);
+            }
+
+            if(std::count(mLocations.begin(), mLocations.end(), mLocations[i]) > 1) {
+                throw Exception(format("parameter %d shares its register with another parameter") % i);
+            }
+        }
+
+        // The object instance is already passed in ECX, and it is not a parameter
+        if(mConvention == CallingConvention::Thiscall && this->HasRegisterParameters()) {
+            throw Exception("methods cannot pass parameters in registers");
+        }
+
+        if(returnLocation != Location::Default && returnLocation != Location::EAX) {
+            if(returnLocation == Location::Stack || !FitsRegister(mReturn)) {
+                throw Exception("the return value cannot be passed in that location");
+            }
+
+            mReturnLocation = returnLocation;
+        }
+    }
+}
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <GoldMeta/Gold/Signature.hpp>
 #include <vector>
 
 #include "DataType.hpp"
+#include "../Exception.hpp"
 
 namespace gm {
     enum class CallingConvention {
@@ -21,6 +23,11 @@ namespace gm {
 
     class ConventionInfo {
     public:
+        /// <summary>
+        /// The exception class that the convention info throws (when given invalid locations)
+        /// </summary>
+        GM_DEFINE_EXCEPTION(Exception);
+
         /// <summary>
         /// Constructs an empty convention info instance
         /// </summary>
@@ -29,7 +36,18 @@ namespace gm {
         /// <summary>
         /// Constructs a convention info instance
         /// </summary>
-        ConventionInfo(CallingConvention cc, DataType returnType, std::vector<DataType> parameterTypes);
+        ConventionInfo(CallingConvention cc, DataType returnType, std::vector<DataType> parameterTypes, bool variadic = false);
+
+        /// <summary>
+        /// Constructs a convention info instance with explicit parameter and return locations (an empty
+        /// vector or 'Location::Default' keeps the convention's own location, e.g 'ECX' and 'EDX' for 'fastcall')
+        /// </summary>
+        ConventionInfo(CallingConvention cc, DataType returnType, std::vector<DataType> parameterTypes, std::vector<Location> locations, Location returnLocation);
+
+        /// <summary>
+        /// Constructs a convention info from a plugin provided signature
+        /// </summary>
+        static ConventionInfo FromSignature(const Signature& signature);
 
         /// <summary>
         ///
@@ -37,7 +55,7 @@ namespace gm {
         CallingConvention GetConvention() const;
 
         /// <summary>
-        ///
+        /// Gets the size of the arguments the caller pushes (including the hidden return address)
         /// </summary>
         size_t GetStackSize() const;
 
@@ -46,6 +64,31 @@ namespace gm {
         /// </summary>
         const std::vector<DataType>& GetParameters() const;
 
+        /// <summary>
+        /// Gets the offset of a parameter relative to the first argument, as if all were passed on the stack
+        /// </summary>
+        size_t GetParameterOffset(size_t index) const;
+
+        /// <summary>
+        /// Gets the location of a parameter (never 'Location::Default')
+        /// </summary>
+        Location GetParameterLocation(size_t index) const;
+
+        /// <summary>
+        /// Gets the register that a return value is passed in (only valid for 'ReturnMethod::EAX')
+        /// </summary>
+        Location GetReturnLocation() const;
+
+        /// <summary>
+        /// Gets whether any parameter is passed in a register
+        /// </summary>
+        bool HasRegisterParameters() const;
+
+        /// <summary>
+        /// Gets whether a parameter is passed in the specified register
+        /// </summary>
+        bool UsesRegister(Location location) const;
+
         /// <summary>
         ///
         /// </summary>
@@ -71,10 +114,28 @@ namespace gm {
         /// </summary>
         bool IsRTL() const;
 
+        /// <summary>
+        /// Gets whether the parameters are followed by variadic arguments (only valid for 'cdecl')
+        /// </summary>
+        bool IsVariadic() const;
+
+        /// <summary>
+        /// Orders convention infos by their signature, so they can be used as keys
+        /// </summary>
+        bool operator<(const ConventionInfo& other) const;
+
     private:
+        /// <summary>
+        /// Resolves the location of each parameter and the return value
+        /// </summary>
+        void AssignLocations(const std::vector<Location>& locations, Location returnLocation);
+
         // Private members
         CallingConvention mConvention;
         std::vector<DataType> mParameters;
+        std::vector<Location> mLocations;
         DataType mReturn;
+        Location mReturnLocation;
+        bool mVariadic;
     };
 }
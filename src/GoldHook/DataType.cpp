@@ -1,17 +1,74 @@
 #include <boost/algorithm/string.hpp>
 #include <unordered_map>
 #include <cassert>
+#include <tuple>
 
 #include "DataType.hpp"
 
 namespace gm {
     DataType::DataType() :
         mIsUnsigned(false),
+        mIsString(false),
         mDataType(Pointer),
         mSize(0)
     {
     }
 
+    DataType DataType::FromDescriptor(const TypeDescriptor& descriptor) {
+        static_assert(static_cast<int>(TypeDescriptor::Void) == static_cast<int>(Void), "The type enumerations must match");
+
+        DataType result;
+        result.mDataType = static_cast<Type>(descriptor.type);
+        result.mIsUnsigned = descriptor.isUnsigned;
+        result.mSize = descriptor.size;
+
+        if(descriptor.type == TypeDescriptor::String) {
+            result.mDataType = Pointer;
+            result.mIsString = true;
+        }
+
+        // The descriptor may come from any plugin, so it is checked against what the generated code supports
+        switch(result.mDataType) {
+            case Pointer:
+                if(result.mSize != sizeof(void*)) {
+                    throw Exception(format("pointers must be %d bytes, not %d") % sizeof(void*) % result.mSize);
+                }
+                break;
+
+            case Integral:
+                if(result.mSize != sizeof(byte) && result.mSize != sizeof(ushort) && result.mSize != sizeof(uint) && result.mSize != sizeof(uint64)) {
+                    throw Exception(format("integers of %d bytes are not supported") % result.mSize);
+                }
+                break;
+
+            case FloatingPoint:
+                // The x87 instructions only load and store 'float' and 'double' ('long double' is not supported)
+                if(result.mSize != sizeof(float) && result.mSize != sizeof(double)) {
+                    throw Exception(format("floating point types of %d bytes are not supported") % result.mSize);
+                }
+                break;
+
+            case Structure:
+                if(result.mSize == 0) {
+                    throw Exception("structures cannot be empty");
+                }
+                break;
+
+            case Class:
+                // A copy constructor would have to be called, which the generated code cannot do
+                throw Exception("classes with constructors cannot be passed by value");
+
+            case Void:
+                result.mSize = 0;
+                break;
+
+            default:
+                throw Exception(format("unknown data type %d") % static_cast<int>(descriptor.type));
+        }
+
+        return result;
+    }
+
     DataType DataType::FromString(const std::string& type) {
         // Use a static map so we only have to create and initialize it once
         static std::unordered_map<std::string, DataType> mapping = {
@@ -69,4 +126,12 @@ namespace gm {
         assert(mDataType == Integral);
         return mIsUnsigned;
     }
-}
\ No newline at end of file
+
+    bool DataType::IsString() const {
+        return mIsString;
+    }
+
+    bool DataType::operator<(const DataType& other) const {
+        return std::tie(mDataType, mSize, mIsUnsigned, mIsString) < std::tie(other.mDataType, other.mSize, other.mIsUnsigned, other.mIsString);
+    }
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <GoldMeta/Gold/Signature.hpp>
 #include <type_traits>
 #include <vector>
 
@@ -36,6 +37,11 @@ namespace gm {
         template <typename T>
         static DataType FromType();
 
+        /// <summary>
+        /// Constructs a data type from a plugin provided type descriptor
+        /// </summary>
+        static DataType FromDescriptor(const TypeDescriptor& descriptor);
+
         /// <summary>
         /// Constructs a data type from a string (e.g 'int', 'void', 'char')
         /// </summary>
@@ -76,9 +82,20 @@ namespace gm {
         /// </summary>
         bool IsUnsigned() const;
 
+        /// <summary>
+        /// Gets whether this pointer points to a null-terminated string (it is otherwise handled like any pointer)
+        /// </summary>
+        bool IsString() const;
+
+        /// <summary>
+        /// Orders data types by their layout, so they can be used as keys
+        /// </summary>
+        bool operator<(const DataType& other) const;
+
     private:
         // Private members
         bool mIsUnsigned;
+        bool mIsString;
         Type mDataType;
         size_t mSize;
     };
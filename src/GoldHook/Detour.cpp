@@ -0,0 +1,92 @@
+#include <cassert>
+#include <cstring>
+
+#include "Detour.hpp"
+#include "../OS/CodeArena.hpp"
+#include "../OS/HotPatch.hpp"
+
+namespace gm {
+    // 'jmp <relative>' - This is probably the best detour type to use
+    const byte Detour::PatchRelative[] = { 0xE9, 0x00, 0x00, 0x00, 0x00 };
+
+    Detour::Detour(void* target) :
+        mTrampoline(nullptr),
+        mTarget(target)
+    {
+        assert(target != nullptr);
+
+        try {
+            // The instructions replaced by the detour are executed from the trampoline instead
+            mRelocator.reset(new Relocator(mTarget, GM_ARRAY_SIZE(PatchRelative)));
+        } catch(const Relocator::Exception& ex) {
+            throw Exception(ex.what());
+        }
+
+        // The trampoline's instructions may differ from the original ones, so these are kept for when the detour is removed
+        mPrologue.assign(static_cast<byte*>(mTarget), static_cast<byte*>(mTarget) + mRelocator->GetSourceSize());
+    }
+
+    void* Detour::CreateTrampoline() {
+        // Threads enter the trampoline without being in an epoch (e.g when it is called from a mid-function
+        // handler, or after they have left the hook handler's one), so it is never known to be unused and
+        // is kept for as long as the process lives. Reapplying the detour reuses it.
+        if(mTrampoline != nullptr) {
+            return mTrampoline;
+        }
+
+        size_t relocatedSize = mRelocator->GetRelocatedSize();
+
+        // Allocate executable memory to backup the original function (i.e the trampoline)
+        mTrampoline = reinterpret_cast<byte*>(CodeArena::GetGlobal().Allocate(relocatedSize + GM_ARRAY_SIZE(PatchRelative), mTarget));
+
+        // Copy the original function instructions to our trampoline (relative ones are adjusted)
+        mRelocator->Relocate(mTrampoline);
+
+        // If the user wants to execute the original function, we must first execute the bytes
+        // that we replaced with the detour, and then jump to the rest of the function. So we
+        // do this by adding a relative jump at the end of our trampoline.
+        byte* jump = &mTrampoline[relocatedSize];
+        std::memcpy(jump, PatchRelative, GM_ARRAY_SIZE(PatchRelative));
+
+        // Calculate the relative address to the rest of the function from the current EIP
+        *reinterpret_cast<uint*>(jump + 0x01) = (static_cast<byte*>(mTarget) + mPrologue.size()) - (jump + GM_ARRAY_SIZE(PatchRelative));
+
+        return mTrampoline;
+    }
+
+    void Detour::Apply(void* callback) {
+        assert(mTrampoline != nullptr);
+        assert(callback != nullptr);
+
+        // The code may be executing whilst it is modified, so the whole patch
+        // is first created in this array and then written by the hot patcher.
+        // Only the jump is written; in case we disassembled more instructions than we've
+        // replaced, the rest are left as they are. They are never reached through the jump,
+        // but a thread that was already past the first of them still finishes them as usual.
+        byte patch[GM_ARRAY_SIZE(PatchRelative)];
+        std::memcpy(patch, PatchRelative, sizeof(patch));
+
+        // Calculate the relative address to the callback function (the user provided one) from the current EIP
+        *reinterpret_cast<uint*>(patch + 0x01) = (static_cast<byte*>(callback) - static_cast<byte*>(mTarget)) - GM_ARRAY_SIZE(PatchRelative);
+
+        try {
+            // Write the patch to the target to detour it!
+            HotPatch::Write(mTarget, patch, sizeof(patch));
+        } catch(const HotPatch::Exception& ex) {
+            throw Exception(ex.what());
+        }
+    }
+
+    void Detour::Remove() {
+        // Only the jump was written, so that is all there is to restore
+        HotPatch::Write(mTarget, mPrologue.data(), GM_ARRAY_SIZE(PatchRelative));
+    }
+
+    void* Detour::GetTrampoline() const {
+        return mTrampoline;
+    }
+
+    size_t Detour::GetSize() const {
+        return mPrologue.size();
+    }
+}
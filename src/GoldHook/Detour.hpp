@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "../Default.hpp"
+#include "../Exception.hpp"
+#include "Relocator.hpp"
+
+namespace gm {
+    /// <summary>
+    /// Redirects code to a callback with a relative jump, keeping the replaced instructions in a trampoline
+    /// </summary>
+    class Detour {
+    public:
+        /// <summary>
+        /// The exception class that the detour throws
+        /// </summary>
+        GM_DEFINE_EXCEPTION(Exception);
+
+        /// <summary>
+        /// Constructs a detour for the instruction at the specified address
+        /// </summary>
+        Detour(void* target);
+
+        /// <summary>
+        /// Builds the trampoline, which executes the replaced instructions and jumps back to the target. It is
+        /// only built once and never released, since a thread may still be executing it at any time.
+        /// </summary>
+        void* CreateTrampoline();
+
+        /// <summary>
+        /// Patches the target to jump to a callback (the trampoline must have been created)
+        /// </summary>
+        void Apply(void* callback);
+
+        /// <summary>
+        /// Restores the target's instructions
+        /// </summary>
+        void Remove();
+
+        /// <summary>
+        /// Gets the trampoline, or null if it has not been created
+        /// </summary>
+        void* GetTrampoline() const;
+
+        /// <summary>
+        /// Gets the number of bytes replaced at the target
+        /// </summary>
+        size_t GetSize() const;
+
+    private:
+        // Private members
+        std::unique_ptr<Relocator> mRelocator;
+        byte* mTrampoline;
+        std::vector<byte> mPrologue;
+        void* mTarget;
+
+        // Static members
+        static const byte PatchRelative[];
+    };
+}
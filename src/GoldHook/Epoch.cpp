@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "Epoch.hpp"
+
+namespace /* Anonymous */ {
+    // These are only used when registering threads and retiring objects, never by a dispatch
+    std::mutex gEpochMutex;
+    std::vector<std::unique_ptr<gm::Epoch::ThreadRecord>> gThreadRecords;
+    std::vector<std::pair<uint64, std::shared_ptr<const void>>> gRetired;
+}
+
+namespace gm {
+    // Zero is reserved for threads that are not reading anything
+    std::atomic<uint64> Epoch::GlobalEpoch(1);
+    thread_local Epoch::ThreadRecord* Epoch::CurrentRecord = nullptr;
+
+    void Epoch::Retire(std::shared_ptr<const void> object) {
+        {
+            std::lock_guard<std::mutex> lock(gEpochMutex);
+
+            // Threads that enter after this point cannot observe the object, since it has already been unpublished
+            gRetired.emplace_back(GlobalEpoch.fetch_add(1, std::memory_order_seq_cst), std::move(object));
+        }
+
+        Epoch::Reclaim();
+    }
+
+    void Epoch::Reclaim() {
+        std::vector<std::shared_ptr<const void>> expired;
+
+        {
+            std::lock_guard<std::mutex> lock(gEpochMutex);
+            uint64 oldest = std::numeric_limits<uint64>::max();
+
+            for(auto& record : gThreadRecords) {
+                uint64 epoch = record->epoch.load(std::memory_order_seq_cst);
+
+                if(epoch != 0) {
+                    oldest = std::min(oldest, epoch);
+                }
+            }
+
+            // An object retired during an epoch may still be read by any thread that entered during it
+            auto reachable = std::partition(gRetired.begin(), gRetired.end(), [oldest](const std::pair<uint64, std::shared_ptr<const void>>& entry) {
+                return entry.first >= oldest;
+            });
+
+            for(auto it = reachable; it != gRetired.end(); ++it) {
+                expired.push_back(std::move(it->second));
+            }
+
+            gRetired.erase(reachable, gRetired.end());
+        }
+
+        // The objects are destroyed outside of the lock, in case they retire something themselves
+        expired.clear();
+    }
+
+    Epoch::ThreadRecord* Epoch::RegisterThread() {
+        // Marks the record as reusable once the thread exits
+        struct Registration {
+            ~Registration() {
+                if(CurrentRecord != nullptr) {
+                    CurrentRecord->epoch.store(0);
+                    CurrentRecord->active.store(false);
+                    CurrentRecord = nullptr;
+                }
+            }
+        };
+
+        static thread_local Registration registration;
+        std::lock_guard<std::mutex> lock(gEpochMutex);
+
+        for(auto& record : gThreadRecords) {
+            bool expected = false;
+
+            if(record->active.compare_exchange_strong(expected, true)) {
+                CurrentRecord = record.get();
+                break;
+            }
+        }
+
+        if(CurrentRecord == nullptr) {
+            gThreadRecords.emplace_back(new ThreadRecord());
+            gThreadRecords.back()->epoch = 0;
+            gThreadRecords.back()->active = true;
+            CurrentRecord = gThreadRecords.back().get();
+        }
+
+        CurrentRecord->depth = 0;
+        (void)registration;
+        return CurrentRecord;
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "../Default.hpp"
+
+namespace gm {
+    class Epoch {
+    public:
+        /// <summary>
+        /// Describes a thread that may read shared data
+        /// </summary>
+        struct ThreadRecord {
+            std::atomic<uint64> epoch; /* The epoch observed when entering, or zero when outside */
+            std::atomic<bool> active;  /* Whether the record belongs to a running thread */
+            size_t depth;              /* The number of nested 'Enter' calls */
+        };
+
+        /// <summary>
+        /// Marks the calling thread as reading shared data (calls may be nested), returning its record
+        /// </summary>
+        static ThreadRecord* Enter();
+
+        /// <summary>
+        /// Marks the calling thread as no longer reading shared data (hook handlers do this in
+        /// assembly with the record returned by 'Enter', see 'CodeGenerator::GetExitStub')
+        /// </summary>
+        static void Exit();
+
+        /// <summary>
+        /// Defers the destruction of an object until no thread can be reading it
+        /// </summary>
+        static void Retire(std::shared_ptr<const void> object);
+
+        /// <summary>
+        /// Destroys all retired objects that are no longer reachable by any thread
+        /// </summary>
+        static void Reclaim();
+
+    private:
+        /// <summary>
+        /// Retrieves (or registers) the calling thread's record
+        /// </summary>
+        static ThreadRecord* GetThreadRecord();
+
+        /// <summary>
+        /// Registers the calling thread
+        /// </summary>
+        static ThreadRecord* RegisterThread();
+
+        // Static members
+        static std::atomic<uint64> GlobalEpoch;
+        static thread_local ThreadRecord* CurrentRecord;
+    };
+
+    inline Epoch::ThreadRecord* Epoch::GetThreadRecord() {
+        ThreadRecord* record = CurrentRecord;
+        return record != nullptr ? record : RegisterThread();
+    }
+
+    inline Epoch::ThreadRecord* Epoch::Enter() {
+        ThreadRecord* record = GetThreadRecord();
+
+        if(record->depth++ == 0) {
+            // This must be visible before any shared pointer is read, hence the sequential consistency
+            record->epoch.store(GlobalEpoch.load(std::memory_order_relaxed), std::memory_order_seq_cst);
+        }
+
+        return record;
+    }
+
+    inline void Epoch::Exit() {
+        ThreadRecord* record = CurrentRecord;
+
+        if(--record->depth == 0) {
+            record->epoch.store(0, std::memory_order_release);
+        }
+    }
+}
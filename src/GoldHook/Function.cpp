@@ -1,6 +1,9 @@
+#include <algorithm>
 #include <cstdlib> // 'alloca'
 #include <cassert>
+#include <cstring>
 
+#include "Epoch.hpp"
 #include "Function.hpp"
 #include "HookContext.hpp"
 #include "ModuleFunction.hpp"
@@ -10,32 +13,120 @@ namespace gm {
         mConventionInfo(cInfo),
         mOriginal(nullptr),
         mDetoured(false),
-        mCallCount(0),
+        mSnapshot(std::make_shared<ModuleSnapshot>()),
+        mEntryAddress(nullptr),
+        mDispatchMode(DispatchMode::Specialized),
+        mActiveCache(nullptr),
+        mActiveQueue(nullptr),
         mCallFunc(nullptr),
         mName(name)
     {
         mCodeGenerator = std::unique_ptr<CodeGenerator>(new CodeGenerator(this));
+        mPublishedSnapshot.store(mSnapshot.get());
+
+        // Each thread has its own hook contexts, which are found by this slot
+        mThreadSlot = HookContextPool::AllocateSlot(mThreadOwner);
     }
 
-    Function::~Function() { }
+    Function::~Function() {
+        if(mAsyncQueue) {
+            AsyncQueue::Unregister(mAsyncQueue.get());
+        }
+
+        HookContextPool::ReleaseSlot(mThreadSlot);
+    }
 
     IModuleFunction* Function::GetModule(PluginId plugin) {
-        // Check if it already exists
-        auto it = mModules.find(plugin);
+        std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
 
+        // This throws if the function cannot be hooked, before the module is added
         this->SetDetour(true);
 
-        if(it != mModules.end()) {
-            return it->second.get();
-        } else {
-            // The function module did not exist, so we add it to our module collection and return it
-            return mModules.insert({ plugin, std::make_shared<ModuleFunction>(plugin, this) }).first->second.get();
-        }
+        // Each request creates a new module, so a plugin may have several listeners on the same function
+        mModules.push_back(std::make_shared<ModuleFunction>(plugin, this));
+        return mModules.back().get();
     }
 
-    void Function::RemoveModule(PluginId plugin) {
-        // No more, no less...
-        mModules.erase(plugin);
+    void Function::RemoveModule(IModuleFunction* module) {
+        // The module may still be used by a dispatch in progress, but the snapshots keep it alive
+        std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+        mModules.erase(std::remove_if(mModules.begin(), mModules.end(), [module](const std::shared_ptr<ModuleFunction>& entry) {
+            return entry.get() == module;
+        }), mModules.end());
+
+        this->OnModulesRemoved();
+    }
+
+    void Function::RemoveModules(PluginId plugin) {
+        std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+        mModules.erase(std::remove_if(mModules.begin(), mModules.end(), [plugin](const std::shared_ptr<ModuleFunction>& entry) {
+            return entry->GetPluginId() == plugin;
+        }), mModules.end());
+
+        this->OnModulesRemoved();
+    }
+
+    std::recursive_mutex& Function::GetUpdateMutex() {
+        return mUpdateMutex;
+    }
+
+    void Function::UpdateModules() {
+        // Only updates are serialized, a dispatch never waits for this lock
+        std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+        std::shared_ptr<ModuleSnapshot> snapshot = std::make_shared<ModuleSnapshot>();
+        std::vector<ModuleFunction*> pre;
+        std::vector<ModuleFunction*> post;
+        std::vector<AsyncTarget> async;
+
+        // Modules with a higher priority are called first, the rest in the order they were added
+        snapshot->modules = mModules;
+        std::stable_sort(snapshot->modules.begin(), snapshot->modules.end(), [](const std::shared_ptr<ModuleFunction>& a, const std::shared_ptr<ModuleFunction>& b) {
+            return a->GetPriority() > b->GetPriority();
+        });
+
+        for(auto& module : snapshot->modules) {
+            // The ranges may be changed by another update while they are read by a dispatch
+            snapshot->callerRanges.push_back(module->GetCallerRanges());
+            snapshot->predicates.push_back(module->GetPredicates());
+
+            if(module->IsCallable(Tense::Pre)) {
+                pre.push_back(module.get());
+            }
+
+            if(module->IsCallable(Tense::Post)) {
+                post.push_back(module.get());
+            }
+
+            if(module->IsCallable(Tense::Async)) {
+                async.push_back({ reinterpret_cast<AsyncListener>(module->GetCallback()), module->GetContext(), snapshot->callerRanges.back(), snapshot->predicates.back(), *module->GetSampler() });
+            }
+        }
+
+        this->UpdateAsyncQueue(std::move(async));
+
+        if(pre.empty() && post.empty() && !mCache && !mAsyncQueue) {
+            // There are no active listeners, so the dispatcher can jump straight to the original
+            snapshot->address = nullptr;
+        } else if(mDispatchMode == DispatchMode::Iterative && !mCache && !mAsyncQueue) {
+            // The generic handler looks up the modules itself, so it never needs to be regenerated
+            snapshot->address = mCodeGenerator->GenerateHookHandler();
+        } else /* Specialized */ {
+            // Generate a handler for the current module set (its modules are kept alive by the snapshot)
+            snapshot->handler = mCodeGenerator->GenerateSpecializedHandler(pre, post);
+            snapshot->address = snapshot->handler.get();
+        }
+
+        // A dispatch reads the snapshot once it has entered the epoch, so the old one is never seen after this
+        mPublishedSnapshot.store(snapshot.get());
+        mEntryAddress.store(snapshot->address != nullptr ? mCodeGenerator->GenerateEntryStub() : this->GetCallableAddress());
+
+        // Threads leave the epoch in the exit stub, after the last instruction of the handler, so the
+        // handler's code is retired (and reclaimed) along with the snapshot that owns it.
+        Epoch::Retire(std::move(mSnapshot));
+        mSnapshot = std::move(snapshot);
     }
 
     void Function::Call(void* returnValue, const void* arguments[]) {
@@ -51,6 +142,12 @@ namespace gm {
             returnValue = alloca(returnSize);
         }
 
+        if(mConventionInfo.IsVariadic()) {
+            // The argument array does not describe any variadic arguments, so they would be garbage
+            std::cerr << format("[WARNING] A plugin tried to generically call variadic function '%s'\n") % mName;
+            return;
+        }
+
         size_t argumentCount = mConventionInfo.GetParameters().size();
 
         if(arguments == nullptr && argumentCount > 0) {
@@ -59,59 +156,264 @@ namespace gm {
             return;
         }
 
-        // Forward the parameters to the call function
-        mCallFunc(returnValue, arguments);
+        // Forward the parameters to the call function (it is shared, so it must be told what to call)
+        mCallFunc(this->GetCallableAddress(), returnValue, arguments);
+    }
+
+    bool Function::SetCacheScope(Cache::Scope scope) {
+        if(scope != Cache::Disabled && (mConventionInfo.IsVariadic() || mConventionInfo.GetReturn().GetType() == DataType::Void)) {
+            std::cerr << format("[WARNING] A plugin tried to memoize function '%s', which is variadic or returns void\n") % mName;
+            return false;
+        }
+
+        const std::vector<DataType>& parameters = mConventionInfo.GetParameters();
+
+        // The key is the arguments' bytes (and the contents of strings), so any other pointer would only be compared
+        // by address, even though what it points at may differ between calls, or be reused for something else
+        if(scope != Cache::Disabled && std::any_of(parameters.begin(), parameters.end(), [](const DataType& type) { return type.GetType() == DataType::Pointer && !type.IsString(); })) {
+            std::cerr << format("[WARNING] A plugin tried to memoize function '%s', which has pointer parameters that are not strings\n") % mName;
+            return false;
+        }
+
+        std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+        if(mCache && mCache->GetScope() == scope) {
+            return true;
+        }
+
+        if(mCache) {
+            // A dispatch in progress may still store its result
+            Epoch::Retire(std::move(mCache));
+        }
+
+        if(scope != Cache::Disabled) {
+            mCache = std::make_shared<ResultCache>(scope, mConventionInfo.GetReturn().GetSize());
+        }
+
+        // Memoizing handlers are always specialized, so their code is owned (and retired) by the snapshots
+        mActiveCache.store(mCache.get());
+        mCodeGenerator->SetMemoized(mCache != nullptr);
+        this->UpdateModules();
+
+        return true;
+    }
+
+    void Function::InvalidateCache() {
+        std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+        if(mCache) {
+            mCache->Clear();
+        }
     }
 
     const ConventionInfo& Function::GetConventionInfo() {
         return mConventionInfo;
     }
 
+    void Function::SetDispatchMode(DispatchMode mode) {
+        if(mDispatchMode != mode) {
+            mDispatchMode = mode;
+            this->UpdateModules();
+        }
+    }
+
+    DispatchMode Function::GetDispatchMode() const {
+        return mDispatchMode;
+    }
+
+    void* Function::GetHookAddress() {
+        // The callable address may have changed since the last detour, so the handler is always updated
+        this->UpdateModules();
+        return mCodeGenerator->GenerateDispatcher(&mEntryAddress);
+    }
+
     void Function::InvalidESP() {
         std::exit(EXIT_FAILURE);
     }
 
-    HookContext* Function::OnEntry() {
-        mCallCount++;
+    void* Function::OnDispatch() {
+        // The epoch must be entered before the snapshot is read, otherwise it could be reclaimed in between
+        Epoch::ThreadRecord* record = Epoch::Enter();
+        const ModuleSnapshot* snapshot = mPublishedSnapshot.load();
 
-        // Some events may lead to a recursive call within the generated assembly, and we must handle
-        // this occasion because otherwise the hook context and module iterator will be overwritten.
-        // The solution is to backup all 'call' specific member variables and use the backup later.
-        if(mCallCount > mModuleIters.size()) {
-            mModuleIters.push_back(mModules.cend());
-        }
-
-        if(mCallCount > mHookContexts.size()) {
-            mHookContexts.emplace_back(std::make_shared<HookContext>(this));
+        if(snapshot->address == nullptr) {
+            // All listeners were disabled since the dispatcher was entered
+            Epoch::Exit();
+            return this->GetCallableAddress();
         }
 
-        // Retrieve the current hook context that will be used
-        HookContext* context = mHookContexts[mCallCount - 1].get();
+        // Some events may lead to a recursive call within the generated assembly, and we must handle
+        // this occasion because otherwise the hook context will be overwritten. The solution is to give
+        // each level of recursion on each thread its own preallocated hook context.
+        HookContext* context = this->GetThreadContexts().Acquire();
 
         context->Reset();
-        return context;
+        context->snapshot = snapshot;
+        context->epochRecord = record;
+        return snapshot->address;
+    }
+
+    HookContext* Function::OnEntry() {
+        // The context was acquired by 'OnDispatch' before the handler was entered
+        return this->GetThreadContexts().GetCurrent();
     }
 
     void Function::OnExit() {
-        mCallCount--;
+        // The epoch is left by the exit stub, since the handler's code is still executed until then
+        this->GetThreadContexts().Release();
     }
 
     IModuleFunction* Function::IterateModule() {
-        // Retrieve the currently used iterator
-        auto& iterator = mModuleIters[mCallCount - 1];
+        // Each dispatch iterates the snapshot it started with, regardless of any updates
+        HookContext* context = this->GetThreadContexts().GetCurrent();
+        const ModuleSnapshot* snapshot = context->snapshot;
+        size_t& index = context->moduleIndex;
 
-        if(iterator == mModules.cend()) {
+        // Modules that are not interested in this call are skipped before they are checked any further
+        while(index < snapshot->modules.size() && (!ModuleFunction::AcceptsCaller(snapshot->callerRanges[index], context->callerAddress) ||
+            !ModuleFunction::AcceptsArguments(snapshot->predicates[index], mConventionInfo, context->arguments) || !this->IsSampled(index, context))) {
+            index++;
+        }
+
+        if(index >= snapshot->modules.size()) {
             return nullptr;
         } else {
-            ModuleFunction* result = iterator->second.get();
-            ++iterator;
+            return snapshot->modules[index++].get();
+        }
+    }
+
+    bool Function::IsSampled(size_t index, HookContext* context) {
+        ModuleFunction* module = context->snapshot->modules[index].get();
+        Sampler* sampler = module->GetSampler();
+
+        // Modules that are not called in this tense must not advance their sampler
+        if(!sampler->IsEnabled() || !module->IsCallable(context->tense)) {
+            return true;
+        }
+
+        // Listeners that are both pre and post see the same calls in both tenses (the first ones, at least)
+        uint pairBit = (index < HookContext::MaxSampledPairs && module->IsCallable(Tense::Pre) && module->IsCallable(Tense::Post)) ? (1u << index) : 0;
 
-            return result;
+        if(pairBit != 0 && context->tense == Tense::Post) {
+            return (context->sampled & pairBit) != 0;
         }
+
+        if(!sampler->Sample()) {
+            return false;
+        }
+
+        context->sampled |= pairBit;
+        return true;
     }
 
     void Function::ResetIterator() {
         // Make the iterator point at the start again
-        mModuleIters[mCallCount - 1] = mModules.cbegin();
+        this->GetThreadContexts().GetCurrent()->moduleIndex = 0;
+    }
+
+    bool Function::OnCacheLookup() {
+        HookContext* context = this->GetThreadContexts().GetCurrent();
+        ResultCache* cache = mActiveCache.load();
+
+        // The function may no longer be memoized, even though this handler was entered
+        context->cache = cache;
+
+        if(cache == nullptr) {
+            return false;
+        }
+
+        const std::vector<DataType>& parameters = mConventionInfo.GetParameters();
+        size_t argumentsSize = parameters.empty() ? 0 : mConventionInfo.GetParameterOffset(parameters.size() - 1) + parameters.back().GetStackSize();
+
+        // The key is taken before any module can modify the arguments, and methods are memoized per object
+        context->cacheKey.assign(reinterpret_cast<const char*>(context->arguments), argumentsSize);
+
+        for(size_t i = 0; i < parameters.size(); i++) {
+            if(!parameters[i].IsString()) {
+                continue;
+            }
+
+            // Strings are identified by their contents, so the address is left out (a null pointer is told apart from an empty string)
+            size_t offset = mConventionInfo.GetParameterOffset(i);
+            const char* string = *reinterpret_cast<const char* const*>(context->arguments + offset);
+
+            context->cacheKey.replace(offset, sizeof(const char*), sizeof(const char*), '\0');
+            context->cacheKey.push_back(string != nullptr);
+
+            if(string != nullptr) {
+                context->cacheKey.append(string, std::strlen(string) + 1);
+            }
+        }
+
+        if(mConventionInfo.IsMethod()) {
+            context->cacheKey.append(reinterpret_cast<const char*>(&context->calleeContext), sizeof(context->calleeContext));
+        }
+
+        if(!cache->Lookup(context->cacheKey, context->overrideReturn)) {
+            return false;
+        }
+
+        // The handler returns the override return, just as if a module had superseded the call
+        context->highestResult = Result::Supersede;
+        return true;
+    }
+
+    void Function::OnCacheStore() {
+        HookContext* context = this->GetThreadContexts().GetCurrent();
+
+        if(context->cache != nullptr) {
+            // This is the value that the handler returns to the caller
+            bool overridden = context->highestResult >= Result::Override;
+            context->cache->Store(context->cacheKey, overridden ? context->overrideReturn : context->originalReturn);
+        }
+    }
+
+    void Function::OnAsyncCapture() {
+        HookContext* context = this->GetThreadContexts().GetCurrent();
+        AsyncQueue* queue = mActiveQueue.load();
+
+        if(queue == nullptr) {
+            return;
+        }
+
+        const byte* returnValue = nullptr;
+
+        if(mConventionInfo.GetReturn().GetType() != DataType::Void) {
+            // This is the value that the handler returns to the caller
+            returnValue = (context->highestResult >= Result::Override) ? context->overrideReturn : context->originalReturn;
+        }
+
+        // A full queue drops the call, since the caller must never wait for the listeners
+        queue->Push(context->arguments, returnValue, context->callerAddress, context->calleeContext);
+    }
+
+    void Function::UpdateAsyncQueue(std::vector<AsyncTarget> targets) {
+        if(targets.empty() && mAsyncQueue) {
+            // A dispatch in progress may still push to the queue, so it is retired rather than destroyed
+            AsyncQueue::Unregister(mAsyncQueue.get());
+            mActiveQueue.store(nullptr);
+            Epoch::Retire(std::move(mAsyncQueue));
+        } else if(!targets.empty()) {
+            if(!mAsyncQueue) {
+                mAsyncQueue = std::make_shared<AsyncQueue>(mName, mConventionInfo);
+                AsyncQueue::Register(mAsyncQueue);
+                mActiveQueue.store(mAsyncQueue.get());
+            }
+
+            mAsyncQueue->SetTargets(std::move(targets));
+        }
+
+        // Capturing handlers are always specialized, so their code is owned (and retired) by the snapshots
+        mCodeGenerator->SetAsyncCapture(mAsyncQueue != nullptr);
+    }
+
+    void Function::OnModulesRemoved() {
+        // This retires the removed modules, even if the detour is removed afterwards
+        this->UpdateModules();
+
+        if(mModules.empty()) {
+            // Nobody is interested in this function any longer, so restore the original code
+            this->SetDetour(false);
+        }
     }
 }
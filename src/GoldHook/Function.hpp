@@ -3,10 +3,15 @@
 #include <string>
 #include <memory>
 #include <vector>
-#include <map>
+#include <atomic>
+#include <mutex>
 
+#include "AsyncQueue.hpp"
 #include "CodeGenerator.hpp"
 #include "ConventionInfo.hpp"
+#include "HookContextPool.hpp"
+#include "ModuleFunction.hpp"
+#include "ResultCache.hpp"
 #include "../Interface/IFunctionBase.hpp"
 
 namespace gm {
@@ -14,6 +19,25 @@ namespace gm {
     class HookContext;
     class ModuleFunction;
 
+    /// <summary>
+    /// Describes how a function dispatches calls to its modules
+    /// </summary>
+    enum class DispatchMode {
+        Iterative,   /* The handler iterates the module collection on each call */
+        Specialized, /* The handler is regenerated with all callable modules hard-coded whenever one changes */
+    };
+
+    /// <summary>
+    /// The modules of a function at one point in time (it is never modified once published)
+    /// </summary>
+    struct ModuleSnapshot {
+        std::vector<std::shared_ptr<ModuleFunction>> modules; /* The modules in dispatch order */
+        std::vector<std::vector<CallerRange>> callerRanges;   /* The caller ranges of each module, as they were */
+        std::vector<std::vector<ArgPredicate>> predicates;    /* The argument predicates of each module, as they were */
+        std::shared_ptr<void> handler;                        /* The specialized handler, if one was generated */
+        void* address;                                        /* The handler address, or null if nothing is callable */
+    };
+
     class Function : public IFunctionBase {
     public:
         /// <summary>
@@ -27,14 +51,29 @@ namespace gm {
         virtual ~Function();
 
         /// <summary>
-        /// Gets a plugin specific function module
+        /// Creates a new function module (i.e listener) for a plugin
         /// </summary>
         virtual IModuleFunction* GetModule(PluginId plugin) final;
 
         /// <summary>
         /// Removes a loaded function module
         /// </summary>
-        virtual void RemoveModule(PluginId plugin) final;
+        virtual void RemoveModule(IModuleFunction* module) final;
+
+        /// <summary>
+        /// Removes all function modules that belong to a plugin
+        /// </summary>
+        virtual void RemoveModules(PluginId plugin) final;
+
+        /// <summary>
+        /// Notifies the function that one of its modules has been modified
+        /// </summary>
+        virtual void UpdateModules() final;
+
+        /// <summary>
+        /// Gets the lock that modules hold while they are modified and published
+        /// </summary>
+        virtual std::recursive_mutex& GetUpdateMutex() final;
 
         /// <summary>
         /// Calls the target function in a generic way
@@ -46,18 +85,48 @@ namespace gm {
         /// </summary>
         virtual const ConventionInfo& GetConventionInfo() final;
 
+        /// <summary>
+        /// Sets how calls are dispatched to the function modules
+        /// </summary>
+        void SetDispatchMode(DispatchMode mode);
+
+        /// <summary>
+        /// Gets how calls are dispatched to the function modules
+        /// </summary>
+        DispatchMode GetDispatchMode() const;
+
+        /// <summary>
+        /// Memoizes the results of the function, returning whether it can be memoized
+        /// </summary>
+        virtual bool SetCacheScope(Cache::Scope scope) final;
+
+        /// <summary>
+        /// Removes all memoized results
+        /// </summary>
+        virtual void InvalidateCache() final;
+
     protected:
         /// <summary>
         /// Constructs a function instance object
         /// </summary>
         Function(std::string name, ConventionInfo cinfo);
 
+        /// <summary>
+        /// Gets the address that the detour should jump to
+        /// </summary>
+        void* GetHookAddress();
+
     private:
         /// <summary>
         /// This method gets called if a generated assembly results in an invalid ESP displacement
         /// </summary>
         virtual void InvalidESP() final;
 
+        /// <summary>
+        /// This method gets called before a handler is entered, and returns the address to jump to
+        /// </summary>
+        virtual void* OnDispatch() final;
+
         /// <summary>
         /// This method gets called when the assembly code is entered
         /// </summary>
@@ -78,6 +147,41 @@ namespace gm {
         /// </summary>
         virtual void ResetIterator() final;
 
+        /// <summary>
+        /// Gets whether the current call is sampled for a module of the snapshot (this advances its sampler)
+        /// </summary>
+        bool IsSampled(size_t index, HookContext* context);
+
+        /// <summary>
+        /// Returns whether the result of the current call is cached (it is then stored as the override return)
+        /// </summary>
+        virtual bool OnCacheLookup() final;
+
+        /// <summary>
+        /// Stores the result of the current call
+        /// </summary>
+        virtual void OnCacheStore() final;
+
+        /// <summary>
+        /// Queues the current call for the asynchronous listeners
+        /// </summary>
+        virtual void OnAsyncCapture() final;
+
+        /// <summary>
+        /// Creates (or removes) the asynchronous queue and sets its listeners (the update mutex must be held)
+        /// </summary>
+        void UpdateAsyncQueue(std::vector<AsyncTarget> targets);
+
+        /// <summary>
+        /// Updates the detour after one or more modules have been removed
+        /// </summary>
+        void OnModulesRemoved();
+
+        /// <summary>
+        /// Gets the calling thread's hook contexts for this function
+        /// </summary>
+        HookContextPool& GetThreadContexts();
+
         /// <summary>
         /// Applies (or removes) the function detour (i.e hook)
         /// </summary>
@@ -91,15 +195,27 @@ namespace gm {
 
     private:
         // Private type definitions
-        typedef std::map<PluginId, std::shared_ptr<ModuleFunction>> ModuleCollection;
+        typedef std::vector<std::shared_ptr<ModuleFunction>> ModuleCollection;
 
         // Private members
+        std::shared_ptr<const ModuleSnapshot> mSnapshot;
+        std::atomic<const ModuleSnapshot*> mPublishedSnapshot;
+        std::shared_ptr<ResultCache> mCache;
+        std::atomic<ResultCache*> mActiveCache;
+        std::shared_ptr<AsyncQueue> mAsyncQueue;
+        std::atomic<AsyncQueue*> mActiveQueue;
+        std::atomic<void*> mEntryAddress;
+        std::recursive_mutex mUpdateMutex;
+        DispatchMode mDispatchMode;
         ModuleCollection mModules;
-        std::vector<ModuleCollection::const_iterator> mModuleIters;
-        std::vector<std::shared_ptr<HookContext>> mHookContexts;
         ConventionInfo mConventionInfo;
         FNCallHook mCallFunc;
         std::string mName;
-        uint mCallCount;
+        size_t mThreadSlot;
+        uint64 mThreadOwner;
     };
+
+    inline HookContextPool& Function::GetThreadContexts() {
+        return HookContextPool::ForThread(this, mThreadSlot, mThreadOwner);
+    }
 }
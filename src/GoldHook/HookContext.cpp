@@ -6,28 +6,51 @@
 
 namespace gm {
     HookContext::HookContext(IFunctionBase* function) :
-        mFunctionBase(function),
+        currentResult(Result::Unset),
+        previousResult(Result::Unset),
+        highestResult(Result::Unset),
+        tense(Tense::Pre),
+        module(nullptr),
+        callerAddress(nullptr),
+        calleeContext(nullptr),
+        originalReturn(nullptr),
+        overrideReturn(nullptr),
+        currentReturn(nullptr),
+        arguments(nullptr),
+        moduleIndex(0),
+        snapshot(nullptr),
+        function(function),
+        cache(nullptr),
         mHiddenReturn(false),
+        mInlineReturn(true),
         mReturnSize(0)
     {
-        mHiddenReturn = mFunctionBase->GetConventionInfo().GetReturnMethod() == ReturnMethod::Hidden;
-        mReturnSize = mFunctionBase->GetConventionInfo().GetReturn().GetSize();
+        mHiddenReturn = this->function->GetConventionInfo().GetReturnMethod() == ReturnMethod::Hidden;
+        mReturnSize = this->function->GetConventionInfo().GetReturn().GetSize();
+        mInlineReturn = mReturnSize <= InlineReturnSize;
+
+        // We don't want the memory to have invalid values
+        std::memset(mReturnBuffers, 0, sizeof(mReturnBuffers));
+        std::memset(this->callerRegisters, 0, sizeof(this->callerRegisters));
 
         if(mReturnSize > 0) {
-            this->overrideReturn = new byte[mReturnSize];
-            this->currentReturn = new byte[mReturnSize];
+            if(mInlineReturn) {
+                this->overrideReturn = mReturnBuffers[0];
+                this->currentReturn = mReturnBuffers[1];
+            } else /* Too large to be stored inline */ {
+                this->overrideReturn = new byte[mReturnSize]();
+                this->currentReturn = new byte[mReturnSize]();
+            }
 
             if(!mHiddenReturn) {
                 // The original return is overridden if the return method is hidden
-                this->originalReturn = new byte[mReturnSize];
+                this->originalReturn = mInlineReturn ? mReturnBuffers[2] : new byte[mReturnSize]();
             }
         }
-
-        this->Reset();
     }
 
     HookContext::~HookContext() {
-        if(mReturnSize > 0) {
+        if(mReturnSize > 0 && !mInlineReturn) {
             delete[] this->overrideReturn;
             delete[] this->currentReturn;
 
@@ -42,9 +65,24 @@ namespace gm {
     }
 
     void HookContext::SetParameter(unsigned int index, const void* value) {
-        // TODO: Implement this
         if((this->tense & Tense::Pre) == 0) {
             std::cerr << "[WARNING] A plugin tried to set a hook context parameter in post\n";
+            return;
+        }
+
+        const ConventionInfo& cInfo = this->function->GetConventionInfo();
+
+        if(index >= cInfo.GetParameters().size() || value == nullptr) {
+            std::cerr << format("[WARNING] A plugin tried to set an invalid hook context parameter (%d)\n") % index;
+            return;
+        }
+
+        // The arguments are overwritten in the caller's frame, so the following modules
+        // and the original function are called with the new value without any copying.
+        std::memcpy(this->arguments + cInfo.GetParameterOffset(index), value, cInfo.GetParameters()[index].GetSize());
+
+        if(this->currentResult < Result::Handled) {
+            this->currentResult = Result::Handled;
         }
     }
 
@@ -91,25 +129,4 @@ namespace gm {
     bool HookContext::IsPre() {
         return this->tense == Tense::Pre;
     }
-
-    void HookContext::Reset() {
-        // Just set each member to its default value
-        this->tense          = Tense::Pre;
-        this->currentResult  = Result::Unset;
-        this->previousResult = Result::Unset;
-        this->highestResult  = Result::Unset;
-        this->callerAddress  = nullptr;
-        this->calleeContext  = nullptr;
-        this->module         = nullptr;
-
-        if(mReturnSize > 0) {
-            // We don't want the memory to have invalid values
-            std::memset(this->overrideReturn, 0, mReturnSize);
-            std::memset(this->currentReturn,  0, mReturnSize);
-
-            if(!mHiddenReturn) {
-                std::memset(this->originalReturn, 0, mReturnSize);
-            }
-        }
-    }
 }
@@ -2,12 +2,33 @@
 
 #include <GoldMeta/Gold/IHookContext.hpp>
 #include <GoldMeta/Gold/IModuleFunction.hpp>
+#include <string>
 
+#include "Epoch.hpp"
 #include "../Interface/IFunctionBase.hpp"
 
 namespace gm {
+    // Forward declarations
+    struct ModuleSnapshot;
+    class ResultCache;
+
     class HookContext : public IHookContext {
     public:
+        /// <summary>
+        /// Return values up to this size are stored within the context itself
+        /// </summary>
+        static const size_t InlineReturnSize = 16;
+
+        /// <summary>
+        /// The number of caller registers saved in the handler frame (EBP, EBX, ESI and EDI)
+        /// </summary>
+        static const size_t CallerRegisterCount = 4;
+
+        /// <summary>
+        /// The number of sampled listeners per call that are guaranteed to see the same calls in pre and post
+        /// </summary>
+        static const size_t MaxSampledPairs = 32;
+
         /// <summary>
         /// Constructs a hook context instance
         /// </summary>
@@ -24,7 +45,7 @@ namespace gm {
         virtual void* GetContext();
 
         /// <summary>
-        /// Sets the value of a specific parameter (must return at least Result::Handled)
+        /// Sets the value of a specific parameter for the following modules and the original function (only valid in pre)
         /// </summary>
         virtual void SetParameter(unsigned int index, const void* value);
 
@@ -69,7 +90,7 @@ namespace gm {
         virtual bool IsPre();
 
         /// <summary>
-        /// Resets all member variables (used before assembly execution)
+        /// Resets the members read by the next call (used before assembly execution)
         /// </summary>
         void Reset();
 
@@ -77,18 +98,38 @@ namespace gm {
         Result currentResult;
         Result previousResult;
         Result highestResult;
+        Tense::Type tense;
+        IModuleFunction* module;
+        void* callerAddress;
+        void* calleeContext;
         byte* originalReturn;
         byte* overrideReturn;
         byte* currentReturn;
-        void* callerAddress;
-        void* calleeContext;
-        IModuleFunction* module;
-        Tense::Type tense;
+        byte* arguments;
+        uintptr_t callerRegisters[CallerRegisterCount];
+        size_t moduleIndex;
+        const ModuleSnapshot* snapshot;
+        IFunctionBase* function;
+        Epoch::ThreadRecord* epochRecord; /* The epoch record that the handler's exit stub leaves */
+        ResultCache* cache;   /* The cache of a memoized call, or null */
+        std::string cacheKey; /* The arguments as they were when the memoized call was entered */
+        uint sampled;         /* The sampled listeners that are called in post as well (one bit each) */
 
     private:
         // Private members
-        IFunctionBase* mFunctionBase;
         size_t mReturnSize;
         bool mHiddenReturn;
+        bool mInlineReturn;
+        byte mReturnBuffers[3][InlineReturnSize];
     };
+
+    inline void HookContext::Reset() {
+        // The remaining members are always written by the assembly before they are read
+        this->tense          = Tense::Pre;
+        this->currentResult  = Result::Unset;
+        this->previousResult = Result::Unset;
+        this->highestResult  = Result::Unset;
+        this->moduleIndex    = 0;
+        this->sampled        = 0;
+    }
 }
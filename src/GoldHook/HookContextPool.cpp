@@ -0,0 +1,81 @@
+#include <cassert>
+#include <mutex>
+#include <new>
+
+#include "HookContextPool.hpp"
+#include "HookContext.hpp"
+
+namespace /* Anonymous */ {
+    // Thread slots are only allocated when functions are created, so a lock is fine here
+    std::mutex gSlotMutex;
+    std::vector<size_t> gFreeSlots;
+    size_t gSlotCount = 0;
+    uint64 gOwnerCount = 0;
+}
+
+namespace gm {
+    thread_local std::vector<std::unique_ptr<HookContextPool>> HookContextPool::ThreadPools;
+
+    HookContextPool::HookContextPool(IFunctionBase* function, uint64 owner, size_t reserve) :
+        mFunctionBase(function),
+        mOwner(owner),
+        mDepth(0)
+    {
+        assert(mFunctionBase != nullptr);
+        assert(reserve > 0);
+
+        // Each context starts on its own cache line, so recursive calls never share one
+        mStride = (sizeof(HookContext) + CacheLineSize - 1) & ~(CacheLineSize - 1);
+        this->Grow(reserve);
+    }
+
+    HookContextPool::~HookContextPool() {
+        assert(mDepth == 0);
+
+        for(HookContext* context : mContexts) {
+            context->~HookContext();
+        }
+    }
+
+    HookContextPool& HookContextPool::CreateForThread(IFunctionBase* function, size_t slot, uint64 owner) {
+        if(slot >= ThreadPools.size()) {
+            ThreadPools.resize(slot + 1);
+        }
+
+        // Any previous pool belonged to a function that no longer exists
+        ThreadPools[slot].reset(new HookContextPool(function, owner));
+        return *ThreadPools[slot];
+    }
+
+    size_t HookContextPool::AllocateSlot(uint64& owner) {
+        std::lock_guard<std::mutex> lock(gSlotMutex);
+        owner = ++gOwnerCount;
+
+        if(gFreeSlots.empty()) {
+            return gSlotCount++;
+        }
+
+        size_t slot = gFreeSlots.back();
+        gFreeSlots.pop_back();
+
+        return slot;
+    }
+
+    void HookContextPool::ReleaseSlot(size_t slot) {
+        std::lock_guard<std::mutex> lock(gSlotMutex);
+        gFreeSlots.push_back(slot);
+    }
+
+    void HookContextPool::Grow(size_t count) {
+        // The memory is aligned manually, since 'new' does not respect over-aligned types
+        std::unique_ptr<byte[]> block(new byte[mStride * count + CacheLineSize - 1]);
+        uintptr_t base = (reinterpret_cast<uintptr_t>(block.get()) + CacheLineSize - 1) & ~(CacheLineSize - 1);
+
+        for(size_t i = 0; i < count; i++) {
+            mContexts.push_back(new (reinterpret_cast<void*>(base + mStride * i)) HookContext(mFunctionBase));
+        }
+
+        // Existing contexts may be in use, so previous blocks are never moved
+        mBlocks.push_back(std::move(block));
+    }
+}
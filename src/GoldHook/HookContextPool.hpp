@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "../Default.hpp"
+
+namespace gm {
+    // Forward declarations
+    class IFunctionBase;
+    class HookContext;
+
+    class HookContextPool {
+    public:
+        /// <summary>
+        /// The alignment of each hook context within the pool
+        /// </summary>
+        static const size_t CacheLineSize = 64;
+
+        /// <summary>
+        /// Constructs a hook context pool with a number of preallocated contexts
+        /// </summary>
+        HookContextPool(IFunctionBase* function, uint64 owner, size_t reserve = 4);
+
+        /// <summary>
+        /// Destructor for the hook context pool
+        /// </summary>
+        ~HookContextPool();
+
+        /// <summary>
+        /// Acquires the hook context for the next (possibly recursive) call
+        /// </summary>
+        HookContext* Acquire();
+
+        /// <summary>
+        /// Releases the most recently acquired hook context
+        /// </summary>
+        void Release();
+
+        /// <summary>
+        /// Gets the most recently acquired hook context
+        /// </summary>
+        HookContext* GetCurrent() const;
+
+        /// <summary>
+        /// Gets the number of hook contexts currently acquired
+        /// </summary>
+        size_t GetDepth() const;
+
+        /// <summary>
+        /// Gets the calling thread's pool for a thread slot (it is created on first use)
+        /// </summary>
+        static HookContextPool& ForThread(IFunctionBase* function, size_t slot, uint64 owner);
+
+        /// <summary>
+        /// Allocates a thread slot and a unique owner identifier for a function
+        /// </summary>
+        static size_t AllocateSlot(uint64& owner);
+
+        /// <summary>
+        /// Returns a thread slot so it can be reused by another function
+        /// </summary>
+        static void ReleaseSlot(size_t slot);
+
+    private:
+        /// <summary>
+        /// Allocates a new block of hook contexts
+        /// </summary>
+        void Grow(size_t count);
+
+        /// <summary>
+        /// Creates the calling thread's pool for a thread slot
+        /// </summary>
+        static HookContextPool& CreateForThread(IFunctionBase* function, size_t slot, uint64 owner);
+
+        // Private members
+        std::vector<std::unique_ptr<byte[]>> mBlocks;
+        std::vector<HookContext*> mContexts;
+        IFunctionBase* mFunctionBase;
+        uint64 mOwner;
+        size_t mStride;
+        size_t mDepth;
+
+        // Static members
+        static thread_local std::vector<std::unique_ptr<HookContextPool>> ThreadPools;
+    };
+
+    inline HookContext* HookContextPool::Acquire() {
+        if(mDepth == mContexts.size()) {
+            // The recursion is deeper than ever before, so double the available contexts
+            this->Grow(mContexts.size());
+        }
+
+        return mContexts[mDepth++];
+    }
+
+    inline void HookContextPool::Release() {
+        mDepth--;
+    }
+
+    inline HookContext* HookContextPool::GetCurrent() const {
+        return mContexts[mDepth - 1];
+    }
+
+    inline size_t HookContextPool::GetDepth() const {
+        return mDepth;
+    }
+
+    inline HookContextPool& HookContextPool::ForThread(IFunctionBase* function, size_t slot, uint64 owner) {
+        // A slot may have belonged to a destroyed function, so the owner must match as well
+        if(slot < ThreadPools.size() && ThreadPools[slot] && ThreadPools[slot]->mOwner == owner) {
+            return *ThreadPools[slot];
+        }
+
+        return CreateForThread(function, slot, owner);
+    }
+}
@@ -0,0 +1,62 @@
+#include <atomic>
+
+#include "ImportFunction.hpp"
+#include "../OS/MemoryRegion.hpp"
+#include "../OS/OS.hpp"
+
+namespace gm {
+    ImportFunction::ImportFunction(std::string name, ConventionInfo cInfo, const std::string& module, const std::string& symbol) :
+        Function(name, cInfo),
+        mSlot(nullptr),
+        mPrevious(nullptr)
+    {
+        Import import;
+
+        try {
+            import = FindImport(module, symbol);
+        } catch(const gm::Exception& ex) {
+            throw Exception(ex.what());
+        }
+
+        mSlot = import.slot;
+        mOriginal = import.address;
+
+        // Keep the generated code close to the function, so it shares pages with the rest of its module
+        mCodeGenerator->SetLocality(mOriginal);
+    }
+
+    void* ImportFunction::GetCallableAddress() {
+        // The library itself is never modified, so there is no need for a trampoline
+        return mOriginal;
+    }
+
+    void ImportFunction::SetDetour(bool enabled) {
+        if(mDetoured == enabled) {
+            return;
+        }
+
+        if(enabled == true) {
+            // A lazily bound slot still points to the resolver stub, which is restored as is
+            mPrevious = *mSlot;
+            this->WriteSlot(this->GetHookAddress());
+            mDetoured = true;
+        } else /* Remove hook */ {
+            this->WriteSlot(mPrevious);
+            mDetoured = false;
+        }
+    }
+
+    void ImportFunction::WriteSlot(void* address) {
+        try {
+            // The slot is read-only with full RELRO (or within the IAT), so it is made writable for a moment,
+            // keeping the page's other flags, since it may share the page with code
+            MemoryRegion region(reinterpret_cast<uintptr_t>(mSlot), sizeof(void*));
+            region.AddFlags(MemoryRegion::Write);
+
+            // The slot is aligned, so other threads either see the old or the new address
+            reinterpret_cast<std::atomic<void*>*>(mSlot)->store(address);
+        } catch(const MemoryRegion::Exception& ex) {
+            throw Exception(ex.what());
+        }
+    }
+}
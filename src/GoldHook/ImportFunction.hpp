@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+#include "Function.hpp"
+
+namespace gm {
+    class ImportFunction : public Function {
+    public:
+        /// <summary>
+        /// The exception that this class throws
+        /// </summary>
+        GM_DEFINE_EXCEPTION_INHERIT(Exception, Function::Exception);
+
+        /// <summary>
+        /// Constructs an import function from a module's import table; only calls
+        /// made from this module are hooked, since the library itself is untouched
+        /// </summary>
+        ImportFunction(std::string name, ConventionInfo cInfo, const std::string& module, const std::string& symbol);
+
+        /// <summary>
+        /// Gets a callable address to the function
+        /// </summary>
+        virtual void* GetCallableAddress();
+
+    private:
+        /// <summary>
+        /// Applies (or removes) the function detour (i.e hook)
+        /// </summary>
+        virtual void SetDetour(bool enabled);
+
+        /// <summary>
+        /// Replaces the address within the import table slot
+        /// </summary>
+        void WriteSlot(void* address);
+
+        // Private members
+        void** mSlot;
+        void* mPrevious;
+    };
+}
@@ -0,0 +1,64 @@
+#include "InstanceFunction.hpp"
+
+namespace gm {
+    InstanceFunction::InstanceFunction(std::string name, ConventionInfo cInfo, void* object, size_t index, size_t slotCount) :
+        Function(name, cInfo),
+        mObject(object),
+        mIndex(index),
+        mSlotCount(slotCount)
+    {
+        if(object == nullptr) {
+            throw Exception("the object is invalid");
+        }
+
+        if(index >= slotCount) {
+            throw Exception("the slot index exceeds the virtual table size");
+        }
+
+        // The shadow is only installed while hooked, but the slot is validated up front
+        this->AcquireShadow();
+        mShadow.reset();
+
+        // Keep the generated code close to the function, so it shares pages with the rest of its module
+        mCodeGenerator->SetLocality(mOriginal);
+    }
+
+    void* InstanceFunction::GetCallableAddress() {
+        // Neither the function nor the class' table is modified, so there is no need for a trampoline
+        return mOriginal;
+    }
+
+    void InstanceFunction::SetDetour(bool enabled) {
+        if(mDetoured == enabled) {
+            return;
+        }
+
+        if(enabled == true) {
+            // The object's class might have changed since the last time it was hooked
+            this->AcquireShadow();
+
+            mDetoured = true;
+            mShadow->SetSlot(mIndex, this->GetHookAddress());
+        } else /* Remove hook */ {
+            mShadow->SetSlot(mIndex, mOriginal);
+            mDetoured = false;
+
+            // Once no slot is hooked, the object is given back its own virtual table
+            mShadow.reset();
+        }
+    }
+
+    void InstanceFunction::AcquireShadow() {
+        mShadow = ShadowVTable::ForObject(mObject, mSlotCount);
+
+        if(!mShadow) {
+            throw Exception("the object already has a smaller shadow virtual table");
+        }
+
+        mOriginal = mShadow->GetOriginal(mIndex);
+
+        if(mOriginal == nullptr) {
+            throw Exception("the virtual table slot is empty");
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "Function.hpp"
+#include "ShadowVTable.hpp"
+
+namespace gm {
+    class InstanceFunction : public Function {
+    public:
+        /// <summary>
+        /// The exception that this class throws
+        /// </summary>
+        GM_DEFINE_EXCEPTION_INHERIT(Exception, Function::Exception);
+
+        /// <summary>
+        /// Constructs an instance function from a slot within an object's virtual table; only
+        /// this object is hooked, since it is given a shadow copy of its class' virtual table
+        /// </summary>
+        InstanceFunction(std::string name, ConventionInfo cInfo, void* object, size_t index, size_t slotCount);
+
+        /// <summary>
+        /// Gets a callable address to the function
+        /// </summary>
+        virtual void* GetCallableAddress();
+
+    private:
+        /// <summary>
+        /// Applies (or removes) the function detour (i.e hook)
+        /// </summary>
+        virtual void SetDetour(bool enabled);
+
+        /// <summary>
+        /// Acquires the object's shadow virtual table
+        /// </summary>
+        void AcquireShadow();
+
+        // Private members
+        std::shared_ptr<ShadowVTable> mShadow;
+        void* mObject;
+        size_t mIndex;
+        size_t mSlotCount;
+    };
+}
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cassert>
+
+#include "Epoch.hpp"
+#include "MidFunction.hpp"
+
+namespace gm {
+    MidModule::MidModule(PluginId id, MidFunction* function) :
+        mFunction(function),
+        mPluginId(id),
+        mListener(nullptr),
+        mContext(nullptr),
+        mPriority(0),
+        mDisabled(false)
+    {
+    }
+
+    void MidModule::SetListener(Listener listener, void* context, int priority) {
+        // The snapshot is built while the function's lock is held, so it never sees a half-set listener
+        std::lock_guard<std::recursive_mutex> lock(mFunction->GetUpdateMutex());
+        mListener = listener;
+        mContext = context;
+        mPriority = priority;
+
+        mFunction->UpdateModules();
+    }
+
+    void MidModule::DisableListener() {
+        std::lock_guard<std::recursive_mutex> lock(mFunction->GetUpdateMutex());
+        mDisabled = true;
+        mFunction->UpdateModules();
+    }
+
+    void MidModule::EnableListener() {
+        std::lock_guard<std::recursive_mutex> lock(mFunction->GetUpdateMutex());
+        mDisabled = false;
+        mFunction->UpdateModules();
+    }
+
+    void MidModule::Release() {
+        mFunction->RemoveModule(this);
+    }
+
+    bool MidModule::IsCallable() const {
+        return !mDisabled && mListener != nullptr;
+    }
+
+    IMidHook::Listener MidModule::GetListener() const {
+        return mListener;
+    }
+
+    void* MidModule::GetContext() const {
+        return mContext;
+    }
+
+    int MidModule::GetPriority() const {
+        return mPriority;
+    }
+
+    PluginId MidModule::GetPluginId() const {
+        return mPluginId;
+    }
+
+    MidFunction::MidFunction(void* address) :
+        mCodeGenerator(new CodeGenerator(ConventionInfo())),
+        mSnapshot(std::make_shared<ModuleSnapshot>()),
+        mHandler(nullptr),
+        mAddress(address),
+        mDetoured(false)
+    {
+        assert(address != nullptr);
+        mPublishedSnapshot.store(mSnapshot.get());
+
+        // Keep the generated code close to the function, so it shares pages with the rest of its module
+        mCodeGenerator->SetLocality(mAddress);
+
+        try {
+            mDetour.reset(new Detour(mAddress));
+        } catch(const Detour::Exception& ex) {
+            throw Exception(ex.what());
+        }
+    }
+
+    MidFunction::~MidFunction() {
+        this->SetDetour(false);
+    }
+
+    IMidHook* MidFunction::GetModule(PluginId plugin) {
+        std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+        // This throws if the instruction cannot be hooked, before the module is added
+        this->SetDetour(true);
+
+        // Each request creates a new module, so a plugin may have several listeners on the same instruction
+        mModules.push_back(std::make_shared<MidModule>(plugin, this));
+        return mModules.back().get();
+    }
+
+    void MidFunction::RemoveModule(IMidHook* module) {
+        std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+        mModules.erase(std::remove_if(mModules.begin(), mModules.end(), [module](const std::shared_ptr<MidModule>& entry) {
+            return entry.get() == module;
+        }), mModules.end());
+
+        this->UpdateModules();
+    }
+
+    void MidFunction::RemoveModules(PluginId plugin) {
+        std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+        mModules.erase(std::remove_if(mModules.begin(), mModules.end(), [plugin](const std::shared_ptr<MidModule>& entry) {
+            return entry->GetPluginId() == plugin;
+        }), mModules.end());
+
+        this->UpdateModules();
+    }
+
+    std::recursive_mutex& MidFunction::GetUpdateMutex() {
+        return mUpdateMutex;
+    }
+
+    void MidFunction::UpdateModules() {
+        std::lock_guard<std::recursive_mutex> lock(mUpdateMutex);
+
+        std::shared_ptr<ModuleSnapshot> snapshot = std::make_shared<ModuleSnapshot>();
+        std::vector<MidModule*> modules;
+
+        for(auto& module : mModules) {
+            if(module->IsCallable()) {
+                modules.push_back(module.get());
+            }
+        }
+
+        // Modules with a higher priority are called first, the rest in the order they were added
+        std::stable_sort(modules.begin(), modules.end(), [](const MidModule* a, const MidModule* b) {
+            return a->GetPriority() > b->GetPriority();
+        });
+
+        // A hit only reads the snapshot, so each listener is always called with its own context
+        for(MidModule* module : modules) {
+            snapshot->listeners.push_back({ module->GetListener(), module->GetContext() });
+        }
+
+        // A hit reads the snapshot once it has entered the epoch, so the old one is never seen after this
+        mPublishedSnapshot.store(snapshot.get());
+        Epoch::Retire(std::move(mSnapshot));
+        mSnapshot = std::move(snapshot);
+
+        if(mModules.empty()) {
+            this->SetDetour(false);
+        }
+    }
+
+    void MidFunction::OnHit(MidFunction* function, Registers* registers) {
+        Epoch::Enter();
+
+        for(const ListenerEntry& entry : function->mPublishedSnapshot.load()->listeners) {
+            entry.listener(registers, entry.context);
+        }
+
+        Epoch::Exit();
+    }
+
+    void MidFunction::SetDetour(bool enabled) {
+        if(mDetoured == enabled) {
+            return;
+        }
+
+        if(enabled == true) {
+            // The handler resumes within the trampoline, and both are kept for as long as the process lives
+            // (threads run them outside any epoch), so they are only generated the first time
+            if(mHandler == nullptr) {
+                void* trampoline = mDetour->CreateTrampoline();
+                mHandler = mCodeGenerator->GenerateMidHandler(this, reinterpret_cast<void*>(&MidFunction::OnHit), trampoline);
+            }
+
+            try {
+                mDetour->Apply(mHandler);
+            } catch(const Detour::Exception& ex) {
+                throw Exception(ex.what());
+            }
+
+            mDetoured = true;
+        } else /* Remove hook */ {
+            mDetour->Remove();
+            mDetoured = false;
+        }
+    }
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <GoldMeta/Gold/IMidHook.hpp>
+#include <GoldMeta/Shared.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "CodeGenerator.hpp"
+#include "Detour.hpp"
+
+namespace gm {
+    // Forward declarations
+    class MidFunction;
+
+    class MidModule : public IMidHook {
+    public:
+        /// <summary>
+        /// Constructs a mid-function module instance
+        /// </summary>
+        MidModule(PluginId id, MidFunction* function);
+
+        /// <summary>
+        /// Sets the current listener for this hook (higher priorities are called first)
+        /// </summary>
+        virtual void SetListener(Listener listener, void* context, int priority = 0);
+
+        /// <summary>
+        /// Disables (pauses) the current listener
+        /// </summary>
+        virtual void DisableListener();
+
+        /// <summary>
+        /// Enables (resumes) the current listener
+        /// </summary>
+        virtual void EnableListener();
+
+        /// <summary>
+        /// Releases the hook
+        /// </summary>
+        virtual void Release();
+
+        /// <summary>
+        /// Gets whether this module can be called or not
+        /// </summary>
+        bool IsCallable() const;
+
+        /// <summary>
+        /// Gets the current listener
+        /// </summary>
+        Listener GetListener() const;
+
+        /// <summary>
+        /// Gets the context that is passed to the listener
+        /// </summary>
+        void* GetContext() const;
+
+        /// <summary>
+        /// Gets the listener priority
+        /// </summary>
+        int GetPriority() const;
+
+        /// <summary>
+        /// Gets the plugin that owns this module
+        /// </summary>
+        PluginId GetPluginId() const;
+
+    private:
+        // Private members
+        MidFunction* mFunction;
+        PluginId mPluginId;
+        Listener mListener;
+        void* mContext;
+        int mPriority;
+        bool mDisabled;
+    };
+
+    class MidFunction {
+    public:
+        /// <summary>
+        /// The exception that this class throws
+        /// </summary>
+        GM_DEFINE_EXCEPTION(Exception);
+
+        /// <summary>
+        /// Constructs a mid-function hook for the instruction at the specified address
+        /// </summary>
+        MidFunction(void* address);
+
+        /// <summary>
+        /// Destructor for the mid-function hook (the instruction is restored)
+        /// </summary>
+        ~MidFunction();
+
+        /// <summary>
+        /// Creates a new module for a plugin
+        /// </summary>
+        IMidHook* GetModule(PluginId plugin);
+
+        /// <summary>
+        /// Removes a module (the instruction is restored once none are left)
+        /// </summary>
+        void RemoveModule(IMidHook* module);
+
+        /// <summary>
+        /// Removes all modules that belong to a plugin
+        /// </summary>
+        void RemoveModules(PluginId plugin);
+
+        /// <summary>
+        /// Publishes the current set of modules
+        /// </summary>
+        void UpdateModules();
+
+        /// <summary>
+        /// Gets the lock that modules hold while they are modified and published
+        /// </summary>
+        std::recursive_mutex& GetUpdateMutex();
+
+    private:
+        /// <summary>
+        /// A listener with the context it was set with, copied from its module when the snapshot is built
+        /// </summary>
+        struct ListenerEntry {
+            IMidHook::Listener listener;
+            void* context;
+        };
+
+        /// <summary>
+        /// The listeners a hit iterates, published as a whole (the modules themselves may be modified meanwhile)
+        /// </summary>
+        struct ModuleSnapshot {
+            std::vector<ListenerEntry> listeners;
+        };
+
+        /// <summary>
+        /// Called by the generated handler whenever the instruction is reached
+        /// </summary>
+        static void OnHit(MidFunction* function, Registers* registers);
+
+        /// <summary>
+        /// Applies (or removes) the detour
+        /// </summary>
+        void SetDetour(bool enabled);
+
+        // Private members
+        std::unique_ptr<CodeGenerator> mCodeGenerator;
+        std::unique_ptr<Detour> mDetour;
+        void* mHandler;
+        std::vector<std::shared_ptr<MidModule>> mModules;
+        std::shared_ptr<const ModuleSnapshot> mSnapshot;
+        std::atomic<const ModuleSnapshot*> mPublishedSnapshot;
+        std::recursive_mutex mUpdateMutex;
+        void* mAddress;
+        bool mDetoured;
+    };
+}
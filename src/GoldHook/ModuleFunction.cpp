@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <cstring>
+
+#include "ConventionInfo.hpp"
 #include "ModuleFunction.hpp"
 #include "../Interface/IFunctionBase.hpp"
+#include "../OS/OS.hpp"
 
 namespace gm {
     ModuleFunction::ModuleFunction(PluginId id, IFunctionBase* functionBase) :
@@ -9,28 +14,73 @@ namespace gm {
         mCallback = nullptr;
         mContext  = nullptr;
         mDisabled = false;
+        mFrameListener = false;
+        mPriority = 0;
+        mTense    = 0;
     }
 
     void* ModuleFunction::GetCallableAddress() {
         return mFunctionBase->GetCallableAddress();
     }
 
-    void ModuleFunction::SetListener(void* function, void* context, int tense) {
+    void ModuleFunction::SetListener(void* function, void* context, int tense, int priority) {
+        if(!IsValidTense(tense, false)) {
+            return;
+        }
+
+        // The function's update reads these, so they are only changed (and published) while it is locked
+        std::lock_guard<std::recursive_mutex> lock(mFunctionBase->GetUpdateMutex());
+        mFrameListener = false;
+        mCallback = function;
+        mContext = context;
+        mTense = tense;
+        mPriority = priority;
+
+        mFunctionBase->UpdateModules();
+    }
+
+    void ModuleFunction::SetFrameListener(void* function, void* context, int tense, int priority) {
+        if(!IsValidTense(tense, true)) {
+            return;
+        }
+
+        std::lock_guard<std::recursive_mutex> lock(mFunctionBase->GetUpdateMutex());
+        mFrameListener = true;
         mCallback = function;
         mContext = context;
         mTense = tense;
+        mPriority = priority;
+
+        mFunctionBase->UpdateModules();
     }
 
     void ModuleFunction::SetListenerTense(int tense) {
+        std::lock_guard<std::recursive_mutex> lock(mFunctionBase->GetUpdateMutex());
+
+        if(!IsValidTense(tense, mFrameListener)) {
+            return;
+        }
+
+        // An asynchronous listener has a different signature, so it cannot become a synchronous one (or vice versa)
+        if(mCallback != nullptr && ((mTense & Tense::Async) != 0) != ((tense & Tense::Async) != 0)) {
+            std::cerr << "[WARNING] A plugin tried to change a listener between asynchronous and synchronous\n";
+            return;
+        }
+
         mTense = tense;
+        mFunctionBase->UpdateModules();
     }
 
     void ModuleFunction::DisableListener() {
+        std::lock_guard<std::recursive_mutex> lock(mFunctionBase->GetUpdateMutex());
         mDisabled = true;
+        mFunctionBase->UpdateModules();
     }
 
     void ModuleFunction::EnableListener() {
+        std::lock_guard<std::recursive_mutex> lock(mFunctionBase->GetUpdateMutex());
         mDisabled = false;
+        mFunctionBase->UpdateModules();
     }
 
     void ModuleFunction::Call(void* returnValue, const void* arguments[]) {
@@ -38,7 +88,7 @@ namespace gm {
     }
 
     void ModuleFunction::Release() {
-        mFunctionBase->RemoveModule(mPluginId);
+        mFunctionBase->RemoveModule(this);
     }
 
     bool ModuleFunction::IsCallable(Tense::Type tense) {
@@ -52,4 +102,216 @@ namespace gm {
     void* ModuleFunction::GetContext() {
         return mContext;
     }
-}
\ No newline at end of file
+
+    bool ModuleFunction::IsFrameListener() {
+        return mFrameListener;
+    }
+
+    void ModuleFunction::AddCallerRange(const void* begin, const void* end) {
+        if(begin >= end) {
+            std::cerr << "[WARNING] A plugin tried to add an empty caller range\n";
+            return;
+        }
+
+        std::lock_guard<std::recursive_mutex> lock(mFunctionBase->GetUpdateMutex());
+        mCallerRanges.push_back({ reinterpret_cast<uintptr_t>(begin), reinterpret_cast<uintptr_t>(end) });
+        mFunctionBase->UpdateModules();
+    }
+
+    bool ModuleFunction::AddCallerModule(const char* module) {
+        if(module == nullptr || std::strlen(module) == 0) {
+            return false;
+        }
+
+        std::vector<Module> modules;
+
+        try {
+            modules = GetProcessModules();
+        } catch(const Exception& ex) {
+            std::cerr << format("[WARNING] Could not enumerate the loaded libraries: %s\n") % ex.what();
+            return false;
+        }
+
+        // The library is identified by its file name, since the directory depends on the installation
+        auto it = std::find_if(modules.begin(), modules.end(), [module](const Module& candidate) {
+            return candidate.path.filename() == module;
+        });
+
+        if(it == modules.end()) {
+            return false;
+        }
+
+        this->AddCallerRange(it->baseAddress, static_cast<byte*>(it->baseAddress) + it->size);
+        return true;
+    }
+
+    void ModuleFunction::ClearCallerRanges() {
+        std::lock_guard<std::recursive_mutex> lock(mFunctionBase->GetUpdateMutex());
+        mCallerRanges.clear();
+        mFunctionBase->UpdateModules();
+    }
+
+    bool ModuleFunction::AddPredicate(const ArgPredicate& predicate) {
+        const ConventionInfo& cInfo = mFunctionBase->GetConventionInfo();
+
+        if(predicate.parameter >= cInfo.GetParameters().size()) {
+            std::cerr << format("[WARNING] A plugin tried to test parameter %d, which does not exist\n") % predicate.parameter;
+            return false;
+        }
+
+        const DataType& type = cInfo.GetParameters()[predicate.parameter];
+
+        // Only values that fit in a register can be compared by the handler
+        if((type.GetType() != DataType::Integral && type.GetType() != DataType::Pointer) || type.GetSize() > sizeof(uint)) {
+            std::cerr << format("[WARNING] A plugin tried to test parameter %d, which is not an integer\n") % predicate.parameter;
+            return false;
+        }
+
+        size_t valueCount = (predicate.type == Predicate::OneOf) ? predicate.count : (predicate.type >= Predicate::Range ? 2 : 1);
+
+        if(predicate.type > Predicate::OneOf || valueCount == 0 || valueCount > ArgPredicate::MaxValues) {
+            std::cerr << "[WARNING] A plugin tried to add an invalid predicate\n";
+            return false;
+        }
+
+        ArgPredicate normalized = predicate;
+        normalized.count = valueCount;
+
+        if(type.GetSize() < sizeof(uint)) {
+            uint bits = type.GetSize() * 8;
+
+            for(size_t i = 0; i < valueCount; i++) {
+                if(predicate.type == Predicate::SignedRange) {
+                    // Small signed arguments are sign extended when they are loaded, so the bounds must be too
+                    uint shift = sizeof(uint) * 8 - bits;
+                    normalized.values[i] = static_cast<uint>(static_cast<int>(predicate.values[i] << shift) >> shift);
+                } else {
+                    // Other arguments are zero extended, so e.g '-1' must be compared as '0xFF' for a 'char'
+                    normalized.values[i] = predicate.values[i] & ((1u << bits) - 1);
+                }
+            }
+        }
+
+        std::lock_guard<std::recursive_mutex> lock(mFunctionBase->GetUpdateMutex());
+        mPredicates.push_back(normalized);
+        mFunctionBase->UpdateModules();
+
+        return true;
+    }
+
+    void ModuleFunction::ClearPredicates() {
+        std::lock_guard<std::recursive_mutex> lock(mFunctionBase->GetUpdateMutex());
+        mPredicates.clear();
+        mFunctionBase->UpdateModules();
+    }
+
+    bool ModuleFunction::SetCacheScope(Cache::Scope scope) {
+        return mFunctionBase->SetCacheScope(scope);
+    }
+
+    void ModuleFunction::InvalidateCache() {
+        mFunctionBase->InvalidateCache();
+    }
+
+    void ModuleFunction::SetSampleInterval(unsigned int interval) {
+        std::lock_guard<std::recursive_mutex> lock(mFunctionBase->GetUpdateMutex());
+
+        // The first call is sampled, so a listener can tell at once that it works
+        mSampler.interval = interval;
+        mSampler.threshold = 0;
+        mSampler.countdown = 1;
+
+        mFunctionBase->UpdateModules();
+    }
+
+    bool ModuleFunction::SetSampleProbability(float probability) {
+        if(!(probability > 0.0f && probability <= 1.0f)) {
+            std::cerr << format("[WARNING] A plugin tried to sample a listener with probability %f\n") % probability;
+            return false;
+        }
+
+        std::lock_guard<std::recursive_mutex> lock(mFunctionBase->GetUpdateMutex());
+        mSampler.interval = 0;
+        mSampler.threshold = (probability < 1.0f) ? std::max(static_cast<uint>(probability * 4294967296.0), 1u) : 0;
+
+        // Each listener has its own sequence, so listeners with the same probability do not see the same calls
+        mSampler.state = static_cast<uint>(reinterpret_cast<uintptr_t>(this) * 2654435761u) | 1;
+
+        mFunctionBase->UpdateModules();
+        return true;
+    }
+
+    Sampler* ModuleFunction::GetSampler() {
+        return &mSampler;
+    }
+
+    const std::vector<ArgPredicate>& ModuleFunction::GetPredicates() const {
+        return mPredicates;
+    }
+
+    bool ModuleFunction::AcceptsArguments(const std::vector<ArgPredicate>& predicates, const ConventionInfo& cInfo, const byte* arguments) {
+        for(const ArgPredicate& predicate : predicates) {
+            const DataType& type = cInfo.GetParameters()[predicate.parameter];
+            const byte* source = arguments + cInfo.GetParameterOffset(predicate.parameter);
+            uint value = 0;
+
+            switch(type.GetSize()) {
+                case sizeof(byte): value = (predicate.type == Predicate::SignedRange) ? static_cast<uint>(*reinterpret_cast<const int8_t*>(source)) : *source; break;
+                case sizeof(ushort): value = (predicate.type == Predicate::SignedRange) ? static_cast<uint>(*reinterpret_cast<const int16_t*>(source)) : *reinterpret_cast<const ushort*>(source); break;
+                default: value = *reinterpret_cast<const uint*>(source); break;
+            }
+
+            bool accepted = false;
+
+            switch(predicate.type) {
+                case Predicate::Equal:       accepted = value == predicate.values[0]; break;
+                case Predicate::NotEqual:    accepted = value != predicate.values[0]; break;
+                case Predicate::AnyBits:     accepted = (value & predicate.values[0]) != 0; break;
+                case Predicate::NoBits:      accepted = (value & predicate.values[0]) == 0; break;
+                case Predicate::Range:       accepted = value >= predicate.values[0] && value <= predicate.values[1]; break;
+                case Predicate::SignedRange: accepted = static_cast<int>(value) >= static_cast<int>(predicate.values[0]) && static_cast<int>(value) <= static_cast<int>(predicate.values[1]); break;
+                case Predicate::OneOf:       accepted = std::find(predicate.values, predicate.values + predicate.count, value) != predicate.values + predicate.count; break;
+            }
+
+            if(!accepted) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    const std::vector<CallerRange>& ModuleFunction::GetCallerRanges() const {
+        return mCallerRanges;
+    }
+
+    bool ModuleFunction::AcceptsCaller(const std::vector<CallerRange>& ranges, const void* address) {
+        uintptr_t caller = reinterpret_cast<uintptr_t>(address);
+
+        return ranges.empty() || std::any_of(ranges.begin(), ranges.end(), [caller](const CallerRange& range) {
+            return caller >= range.begin && caller < range.end;
+        });
+    }
+
+    bool ModuleFunction::IsValidTense(int tense, bool frameListener) {
+        if((tense & Tense::Async) == 0) {
+            return true;
+        }
+
+        if(tense != Tense::Async || frameListener) {
+            // The listener types differ, so one callback cannot serve both
+            std::cerr << "[WARNING] A plugin tried to combine an asynchronous listener with a synchronous tense\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    int ModuleFunction::GetPriority() const {
+        return mPriority;
+    }
+
+    PluginId ModuleFunction::GetPluginId() const {
+        return mPluginId;
+    }
+}
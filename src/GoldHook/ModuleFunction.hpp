@@ -2,10 +2,81 @@
 
 #include <GoldMeta/Gold/IModuleFunction.hpp>
 #include <GoldMeta/Shared.hpp>
+#include <vector>
+#include <atomic>
+
+#include "../Default.hpp"
 
 namespace gm {
     // Forward declarations
     class IFunctionBase;
+    class ConventionInfo;
+
+    /// <summary>
+    /// A range of return addresses that a listener is called for
+    /// </summary>
+    struct CallerRange {
+        uintptr_t begin;
+        uintptr_t end; /* Exclusive */
+    };
+
+    /// <summary>
+    /// Decides which calls a sampled listener is called for. The random state is not synchronized, since
+    /// an occasional repeated sample does not matter, but the countdown is (a lost update could skip past
+    /// zero, and then no call would be sampled until it wraps around).
+    /// </summary>
+    struct Sampler {
+        Sampler() :
+            interval(0),
+            threshold(0),
+            countdown(0),
+            state(0)
+        {
+        }
+
+        Sampler(const Sampler& other) :
+            interval(other.interval),
+            threshold(other.threshold),
+            countdown(other.countdown.load(std::memory_order_relaxed)),
+            state(other.state)
+        {
+        }
+
+        uint interval;              /* The number of calls per sample, or zero */
+        uint threshold;             /* The random state must be below this to take a sample, or zero */
+        std::atomic<int> countdown; /* The number of calls until the next sample (negative while it is being reset) */
+        uint state;                 /* The xorshift state, which is never zero */
+
+        /// <summary>
+        /// Gets whether only some calls are sampled
+        /// </summary>
+        bool IsEnabled() const {
+            return interval > 1 || threshold != 0;
+        }
+
+        /// <summary>
+        /// Advances the sampler, returning whether the current call is sampled
+        /// </summary>
+        bool Sample() {
+            if(interval > 1) {
+                // Only the call that takes the countdown to zero is sampled, and the calls made before it is
+                // reset (which take it below zero) count towards the next interval, since it is added to
+                if(countdown.fetch_sub(1, std::memory_order_relaxed) != 1) {
+                    return false;
+                }
+
+                countdown.fetch_add(static_cast<int>(interval), std::memory_order_relaxed);
+                return true;
+            } else if(threshold != 0) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                return state < threshold;
+            }
+
+            return true;
+        }
+    };
 
     class ModuleFunction : public IModuleFunction {
     public:
@@ -20,9 +91,9 @@ namespace gm {
         virtual void* GetCallableAddress();
 
         /// <summary>
-        /// Sets the current listener for this function module
+        /// Sets the current listener for this function module (higher priorities are called first)
         /// </summary>
-        virtual void SetListener(void* function, void* context, int tense);
+        virtual void SetListener(void* function, void* context, int tense, int priority = 0);
 
         /// <summary>
         /// Sets the listener tense (can be both pre and post simultaneously)
@@ -64,13 +135,113 @@ namespace gm {
         /// </summary>
         virtual void* GetContext();
 
+        /// <summary>
+        /// Sets a listener that receives '(IHookContext*, const ArgFrame*)' instead of a copy of each argument
+        /// </summary>
+        virtual void SetFrameListener(void* function, void* context, int tense, int priority = 0);
+
+        /// <summary>
+        /// Gets whether the listener receives an argument frame
+        /// </summary>
+        virtual bool IsFrameListener();
+
+        /// <summary>
+        /// Restricts the listener to calls with a return address within [begin, end)
+        /// </summary>
+        virtual void AddCallerRange(const void* begin, const void* end);
+
+        /// <summary>
+        /// Restricts the listener to calls from a loaded library, returning whether it was found
+        /// </summary>
+        virtual bool AddCallerModule(const char* module);
+
+        /// <summary>
+        /// Removes all caller ranges
+        /// </summary>
+        virtual void ClearCallerRanges();
+
+        /// <summary>
+        /// Adds a predicate that all calls must pass for the listener to be called
+        /// </summary>
+        virtual bool AddPredicate(const ArgPredicate& predicate);
+
+        /// <summary>
+        /// Removes all predicates
+        /// </summary>
+        virtual void ClearPredicates();
+
+        /// <summary>
+        /// Memoizes the function's results with the specified invalidation scope
+        /// </summary>
+        virtual bool SetCacheScope(Cache::Scope scope);
+
+        /// <summary>
+        /// Removes all memoized results of the function
+        /// </summary>
+        virtual void InvalidateCache();
+
+        /// <summary>
+        /// Calls the listener for every Nth call only
+        /// </summary>
+        virtual void SetSampleInterval(unsigned int interval);
+
+        /// <summary>
+        /// Calls the listener for a random subset of the calls
+        /// </summary>
+        virtual bool SetSampleProbability(float probability);
+
+        /// <summary>
+        /// Gets the sampler (its address is embedded in specialized handlers)
+        /// </summary>
+        Sampler* GetSampler();
+
+        /// <summary>
+        /// Gets the argument predicates (the values are truncated to the parameter's size)
+        /// </summary>
+        const std::vector<ArgPredicate>& GetPredicates() const;
+
+        /// <summary>
+        /// Gets whether the arguments, laid out as on the stack, pass all predicates
+        /// </summary>
+        static bool AcceptsArguments(const std::vector<ArgPredicate>& predicates, const ConventionInfo& cInfo, const byte* arguments);
+
+        /// <summary>
+        /// Gets the caller ranges (empty if the listener is called for all callers)
+        /// </summary>
+        const std::vector<CallerRange>& GetCallerRanges() const;
+
+        /// <summary>
+        /// Gets whether the caller ranges accept a return address
+        /// </summary>
+        static bool AcceptsCaller(const std::vector<CallerRange>& ranges, const void* address);
+
+        /// <summary>
+        /// Gets the listener priority
+        /// </summary>
+        int GetPriority() const;
+
+        /// <summary>
+        /// Gets the plugin that owns this module
+        /// </summary>
+        PluginId GetPluginId() const;
+
     private:
+        /// <summary>
+        /// Gets whether a tense can be used by a listener (asynchronous listeners cannot be synchronous as well)
+        /// </summary>
+        static bool IsValidTense(int tense, bool frameListener);
+
         // Private members
         IFunctionBase* mFunctionBase;
         PluginId mPluginId;
+        std::vector<CallerRange> mCallerRanges;
+        std::vector<ArgPredicate> mPredicates;
+        Sampler mSampler;
         void* mCallback;
         void* mContext;
         bool mDisabled;
+        bool mFrameListener;
+        int mPriority;
         int mTense;
     };
 }
@@ -0,0 +1,208 @@
+#include <udis86.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "Relocator.hpp"
+
+namespace /* Anonymous */ {
+    // The page containing the decoded instructions is known to be mapped, but not the one after it
+    const uintptr_t PageSize = 4096;
+
+    // The size of each relative instruction that is emitted
+    const size_t JumpLength = 5;
+    const size_t PushLength = 5;
+    const size_t BranchLength = 6;
+    const size_t ShortJumpLength = 2;
+
+    void WriteRelative(byte* position, uintptr_t target) {
+        // The displacement is relative to the end of the instruction, which is where the displacement ends
+        *reinterpret_cast<uint*>(position) = static_cast<uint>(target - reinterpret_cast<uintptr_t>(position + sizeof(uint)));
+    }
+
+    bool GetRelativeTarget(const ud_t& ud, uintptr_t& target) {
+        const ud_operand* operand = ud_insn_opr(&ud, 0);
+
+        if(operand == nullptr || operand->type != UD_OP_JIMM) {
+            return false;
+        }
+
+        int32_t displacement = 0;
+
+        switch(operand->size) {
+            case 8:  displacement = operand->lval.sbyte;  break;
+            case 16: displacement = operand->lval.sword;  break;
+            case 32: displacement = operand->lval.sdword; break;
+        }
+
+        target = static_cast<uintptr_t>(ud_insn_off(&ud)) + ud_insn_len(&ud) + displacement;
+        return true;
+    }
+}
+
+namespace gm {
+    Relocator::Relocator(const void* code, size_t minimumSize) :
+        mCode(static_cast<const byte*>(code)),
+        mSourceSize(0)
+    {
+        assert(code != nullptr);
+        assert(minimumSize > 0);
+
+        ud_t ud;
+        ud_init(&ud);
+
+        // Only the bytes that can belong to the instructions are read, since the function might be at the end of its memory
+        ud_set_input_buffer(&ud, mCode, minimumSize + MaxInstructionLength - 1);
+        ud_set_pc(&ud, reinterpret_cast<uintptr_t>(mCode));
+        ud_set_mode(&ud, 32);
+
+        while(mSourceSize < minimumSize) {
+            size_t length = ud_disassemble(&ud);
+            auto mnemonic = ud_insn_mnemonic(&ud);
+
+            if(length == 0 || mnemonic == UD_Iinvalid) {
+                throw Exception("couldn't disassemble enough bytes from target address");
+            }
+
+            Instruction instruction = { mCode + mSourceSize, length, Kind::Plain, 0, 0 };
+
+            if(GetRelativeTarget(ud, instruction.target)) {
+                if(ud_insn_opr(&ud, 0)->size == 16) {
+                    throw Exception("16-bit relative instructions cannot be relocated");
+                }
+
+                switch(mnemonic) {
+                    case UD_Icall:   instruction.kind = Kind::Call; break;
+                    case UD_Ijmp:    instruction.kind = Kind::Jump; break;
+                    case UD_Iloop:
+                    case UD_Iloope:
+                    case UD_Iloopne:
+                    case UD_Ijcxz:
+                    case UD_Ijecxz:  instruction.kind = Kind::ShortOnly; break;
+                    default:
+                        // The condition is the low nibble of both the short (0x7X) and near (0x0F 0x8X) opcode
+                        instruction.kind = Kind::Branch;
+                        instruction.condition = instruction.address[length - (ud_insn_opr(&ud, 0)->size == 8 ? 2 : 5)] & 0x0F;
+                        break;
+                }
+            }
+
+            mInstructions.push_back(instruction);
+            mSourceSize += length;
+
+            // Whatever follows an unconditional transfer belongs to something else, which must not be overwritten
+            bool isFinal = (mnemonic == UD_Ijmp || mnemonic == UD_Iret || mnemonic == UD_Iretf || mnemonic == UD_Iint3);
+
+            if(isFinal && mSourceSize < minimumSize) {
+                throw Exception("the function is too short to be hooked");
+            }
+        }
+
+        for(const Instruction& instruction : mInstructions) {
+            // A loop within the decoded instructions would jump into the detour once they are replaced
+            if(instruction.kind != Kind::Plain && instruction.target > reinterpret_cast<uintptr_t>(mCode) && instruction.target < reinterpret_cast<uintptr_t>(mCode + mSourceSize)) {
+                throw Exception("the first instructions of the function jump into themselves");
+            }
+        }
+
+        this->CheckJumpTargets();
+    }
+
+    size_t Relocator::GetSourceSize() const {
+        return mSourceSize;
+    }
+
+    size_t Relocator::GetRelocatedSize() const {
+        size_t size = 0;
+
+        for(const Instruction& instruction : mInstructions) {
+            size += GetRelocatedLength(instruction);
+        }
+
+        return size;
+    }
+
+    void Relocator::Relocate(void* destination) const {
+        byte* output = static_cast<byte*>(destination);
+
+        for(const Instruction& instruction : mInstructions) {
+            switch(instruction.kind) {
+                case Kind::Plain:
+                    std::memcpy(output, instruction.address, instruction.length);
+                    break;
+
+                case Kind::Call:
+                    // The return address is kept, since the callee might read it (e.g '__x86.get_pc_thunk')
+                    output[0] = 0x68;
+                    *reinterpret_cast<uint*>(output + 1) = reinterpret_cast<uintptr_t>(instruction.address + instruction.length);
+                    output[PushLength] = 0xE9;
+                    WriteRelative(output + PushLength + 1, instruction.target);
+                    break;
+
+                case Kind::Jump:
+                    output[0] = 0xE9;
+                    WriteRelative(output + 1, instruction.target);
+                    break;
+
+                case Kind::Branch:
+                    output[0] = 0x0F;
+                    output[1] = 0x80 | instruction.condition;
+                    WriteRelative(output + 2, instruction.target);
+                    break;
+
+                case Kind::ShortOnly:
+                    // 'loop <taken>; jmp short <skip>; taken: jmp rel32 <target>; skip:'
+                    std::memcpy(output, instruction.address, instruction.length);
+                    output[instruction.length - 1] = ShortJumpLength;
+                    output[instruction.length + 0] = 0xEB;
+                    output[instruction.length + 1] = JumpLength;
+                    output[instruction.length + 2] = 0xE9;
+                    WriteRelative(output + instruction.length + ShortJumpLength + 1, instruction.target);
+                    break;
+            }
+
+            output += GetRelocatedLength(instruction);
+        }
+    }
+
+    size_t Relocator::GetRelocatedLength(const Instruction& instruction) {
+        switch(instruction.kind) {
+            case Kind::Call:      return PushLength + JumpLength;
+            case Kind::Jump:      return JumpLength;
+            case Kind::Branch:    return BranchLength;
+            case Kind::ShortOnly: return instruction.length + ShortJumpLength + JumpLength;
+            default:              return instruction.length;
+        }
+    }
+
+    void Relocator::CheckJumpTargets() const {
+        const byte* start = mCode + mSourceSize;
+        uintptr_t pageEnd = ((reinterpret_cast<uintptr_t>(start) - 1) | (PageSize - 1)) + 1;
+        size_t length = std::min<size_t>(ScanLength, pageEnd - reinterpret_cast<uintptr_t>(start));
+
+        if(length == 0) {
+            return;
+        }
+
+        ud_t ud;
+        ud_init(&ud);
+
+        ud_set_input_buffer(&ud, start, length);
+        ud_set_pc(&ud, reinterpret_cast<uintptr_t>(start));
+        ud_set_mode(&ud, 32);
+
+        // A linear sweep may lose track after data or padding, but it would only cause a false refusal
+        while(ud_disassemble(&ud) != 0) {
+            auto mnemonic = ud_insn_mnemonic(&ud);
+            uintptr_t target;
+
+            if(mnemonic == UD_Iinvalid || mnemonic == UD_Iint3) {
+                break;
+            }
+
+            if(GetRelativeTarget(ud, target) && target > reinterpret_cast<uintptr_t>(mCode) && target < reinterpret_cast<uintptr_t>(start)) {
+                throw Exception("the first instructions of the function are a jump target");
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+
+#include "../Default.hpp"
+#include "../Exception.hpp"
+
+namespace gm {
+    /// <summary>
+    /// Copies the first instructions of a function to another address, adjusting any relative ones
+    /// </summary>
+    class Relocator {
+    public:
+        /// <summary>
+        /// The exception class that the relocator throws
+        /// </summary>
+        GM_DEFINE_EXCEPTION(Exception);
+
+        /// <summary>
+        /// The maximum length of an x86 instruction
+        /// </summary>
+        static const size_t MaxInstructionLength = 15;
+
+        /// <summary>
+        /// The number of bytes after the relocated instructions that are searched for jumps back into them
+        /// </summary>
+        static const size_t ScanLength = 256;
+
+        /// <summary>
+        /// Decodes whole instructions until at least 'minimumSize' bytes are covered
+        /// </summary>
+        Relocator(const void* code, size_t minimumSize);
+
+        /// <summary>
+        /// Gets the number of bytes covered by the decoded instructions
+        /// </summary>
+        size_t GetSourceSize() const;
+
+        /// <summary>
+        /// Gets the number of bytes the instructions occupy once relocated
+        /// </summary>
+        size_t GetRelocatedSize() const;
+
+        /// <summary>
+        /// Writes the instructions to a destination, with relative targets adjusted for its address
+        /// </summary>
+        void Relocate(void* destination) const;
+
+    private:
+        /// <summary>
+        /// Describes how an instruction is relocated
+        /// </summary>
+        enum class Kind {
+            Plain,     /* Copied as is */
+            Call,      /* 'call rel32' becomes 'push <return>; jmp rel32' */
+            Jump,      /* 'jmp rel8/rel32' becomes 'jmp rel32' */
+            Branch,    /* 'jcc rel8/rel32' becomes 'jcc rel32' */
+            ShortOnly, /* 'loop' and 'jecxz' only exist with 'rel8', so they jump over a 'jmp rel32' */
+        };
+
+        /// <summary>
+        /// Describes a decoded instruction
+        /// </summary>
+        struct Instruction {
+            const byte* address;
+            size_t length;
+            Kind kind;
+            uintptr_t target; /* The absolute target of a relative instruction */
+            byte condition;   /* The condition code of a branch */
+        };
+
+        /// <summary>
+        /// Gets the size of an instruction once relocated
+        /// </summary>
+        static size_t GetRelocatedLength(const Instruction& instruction);
+
+        /// <summary>
+        /// Ensures that no jump after the decoded instructions targets their middle
+        /// </summary>
+        void CheckJumpTargets() const;
+
+        // Private members
+        std::vector<Instruction> mInstructions;
+        const byte* mCode;
+        size_t mSourceSize;
+    };
+}
@@ -0,0 +1,84 @@
+#include <cassert>
+#include <cstring>
+
+#include "ResultCache.hpp"
+
+namespace gm {
+    std::atomic<uint64> ResultCache::FrameGeneration(0);
+    std::atomic<uint64> ResultCache::MapGeneration(0);
+
+    ResultCache::ResultCache(Cache::Scope scope, size_t returnSize) :
+        mScope(scope),
+        mReturnSize(returnSize),
+        mGeneration(GetGeneration(scope))
+    {
+        assert(scope != Cache::Disabled);
+    }
+
+    void ResultCache::Advance(Cache::Scope scope) {
+        switch(scope) {
+            case Cache::Map:
+                MapGeneration++;
+                // Fall through, since the results of the previous frame belong to the previous map
+
+            case Cache::Frame:
+                FrameGeneration++;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    bool ResultCache::Lookup(const std::string& key, byte* result) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        this->Validate();
+
+        auto it = mResults.find(key);
+
+        if(it == mResults.end()) {
+            return false;
+        }
+
+        std::memcpy(result, it->second.data(), mReturnSize);
+        return true;
+    }
+
+    void ResultCache::Store(const std::string& key, const byte* result) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        this->Validate();
+
+        if(mResults.size() >= MaxEntries) {
+            // The arguments are not as stable as assumed, so it is cheaper to start over than to track usage
+            mResults.clear();
+        }
+
+        mResults[key].assign(result, result + mReturnSize);
+    }
+
+    void ResultCache::Clear() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mResults.clear();
+    }
+
+    Cache::Scope ResultCache::GetScope() const {
+        return mScope;
+    }
+
+    uint64 ResultCache::GetGeneration(Cache::Scope scope) {
+        switch(scope) {
+            case Cache::Frame: return FrameGeneration.load(std::memory_order_relaxed);
+            case Cache::Map:   return MapGeneration.load(std::memory_order_relaxed);
+            default:           return 0;
+        }
+    }
+
+    void ResultCache::Validate() {
+        uint64 generation = GetGeneration(mScope);
+
+        if(generation != mGeneration) {
+            mResults.clear();
+            mGeneration = generation;
+        }
+    }
+}
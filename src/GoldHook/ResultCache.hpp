@@ -0,0 +1,72 @@
+#pragma once
+
+#include <GoldMeta/Gold/IModuleFunction.hpp>
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+#include "../Default.hpp"
+
+namespace gm {
+    class ResultCache {
+    public:
+        /// <summary>
+        /// The maximum number of results kept before the cache is cleared
+        /// </summary>
+        static const size_t MaxEntries = 4096;
+
+        /// <summary>
+        /// Constructs a result cache for return values of the specified size
+        /// </summary>
+        ResultCache(Cache::Scope scope, size_t returnSize);
+
+        /// <summary>
+        /// Invalidates all caches with the specified scope (a new map also starts a new frame)
+        /// </summary>
+        static void Advance(Cache::Scope scope);
+
+        /// <summary>
+        /// Copies the result stored for the arguments, returning whether one was found
+        /// </summary>
+        bool Lookup(const std::string& key, byte* result);
+
+        /// <summary>
+        /// Stores the result for the arguments
+        /// </summary>
+        void Store(const std::string& key, const byte* result);
+
+        /// <summary>
+        /// Removes all results
+        /// </summary>
+        void Clear();
+
+        /// <summary>
+        /// Gets the invalidation scope
+        /// </summary>
+        Cache::Scope GetScope() const;
+
+    private:
+        /// <summary>
+        /// Gets the current generation of a scope
+        /// </summary>
+        static uint64 GetGeneration(Cache::Scope scope);
+
+        /// <summary>
+        /// Removes all results if the scope has advanced since they were stored (the mutex must be held)
+        /// </summary>
+        void Validate();
+
+        // Private members
+        std::unordered_map<std::string, std::vector<byte>> mResults;
+        std::mutex mMutex;
+        Cache::Scope mScope;
+        size_t mReturnSize;
+        uint64 mGeneration;
+
+        // Static members
+        static std::atomic<uint64> FrameGeneration;
+        static std::atomic<uint64> MapGeneration;
+    };
+}
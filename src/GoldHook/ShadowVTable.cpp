@@ -0,0 +1,87 @@
+#include <atomic>
+#include <cassert>
+#include <map>
+#include <mutex>
+
+#include "Epoch.hpp"
+#include "ShadowVTable.hpp"
+
+namespace /* Anonymous */ {
+    // Shadow tables are only created and destroyed when hooks are modified, so a lock is fine here
+    std::mutex gShadowMutex;
+    std::map<void*, std::weak_ptr<gm::ShadowVTable>> gShadows;
+
+    std::atomic<void**>& VTablePointer(void* object) {
+        return *reinterpret_cast<std::atomic<void**>*>(object);
+    }
+}
+
+namespace gm {
+    std::shared_ptr<ShadowVTable> ShadowVTable::ForObject(void* object, size_t slotCount) {
+        assert(object != nullptr);
+        std::lock_guard<std::mutex> lock(gShadowMutex);
+
+        std::shared_ptr<ShadowVTable> shadow = gShadows[object].lock();
+
+        // The address may have been reused by another object since the shadow was installed
+        if(shadow && VTablePointer(object).load() != shadow->mTable) {
+            shadow.reset();
+        }
+
+        if(!shadow) {
+            shadow.reset(new ShadowVTable(object, slotCount));
+            gShadows[object] = shadow;
+        } else if(shadow->mSlotCount < slotCount) {
+            // The table cannot grow, since hooks already point into the installed one
+            return nullptr;
+        }
+
+        return shadow;
+    }
+
+    ShadowVTable::ShadowVTable(void* object, size_t slotCount) :
+        mSlots(new void*[PrefixSlots + slotCount]),
+        mObject(object),
+        mSlotCount(slotCount)
+    {
+        assert(slotCount > 0);
+
+        void** current = VTablePointer(object).load();
+        mOriginal = current;
+
+        // Copy the preceding slots as well, so 'dynamic_cast' and 'typeid' keep working
+        for(size_t i = 0; i < PrefixSlots + slotCount; i++) {
+            mSlots[i] = current[static_cast<ptrdiff_t>(i) - static_cast<ptrdiff_t>(PrefixSlots)];
+        }
+
+        mTable = &mSlots[PrefixSlots];
+        VTablePointer(object).store(mTable);
+    }
+
+    ShadowVTable::~ShadowVTable() {
+        void** expected = mTable;
+
+        // The object may have been destroyed (and its memory reused), so it is only restored if it still uses this table
+        VTablePointer(mObject).compare_exchange_strong(expected, mOriginal);
+
+        // A call may have loaded the shadow table just before it was swapped back, and still be about to
+        // read its slot, so the slots are only released once the threads in the current epoch have left.
+        Epoch::Retire(std::shared_ptr<void*>(mSlots.release(), std::default_delete<void*[]>()));
+    }
+
+    void ShadowVTable::SetSlot(size_t index, void* address) {
+        assert(index < mSlotCount);
+
+        // The slot is aligned, so a call either sees the old or the new address
+        reinterpret_cast<std::atomic<void*>*>(&mTable[index])->store(address);
+    }
+
+    void* ShadowVTable::GetOriginal(size_t index) const {
+        assert(index < mSlotCount);
+        return mOriginal[index];
+    }
+
+    size_t ShadowVTable::GetSlotCount() const {
+        return mSlotCount;
+    }
+}
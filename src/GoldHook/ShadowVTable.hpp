@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "../Default.hpp"
+
+namespace gm {
+    /// <summary>
+    /// A copy of an object's virtual table, used to hook the virtual functions of a single instance
+    /// </summary>
+    class ShadowVTable {
+    public:
+        /// <summary>
+        /// The number of slots preceding the virtual table (RTTI, and the offset to top on GCC)
+        /// </summary>
+        static const size_t PrefixSlots = 2;
+
+        /// <summary>
+        /// Gets the shadow virtual table of an object, which is installed if it does not exist yet
+        /// (null is returned if the installed table has fewer slots than requested)
+        /// </summary>
+        static std::shared_ptr<ShadowVTable> ForObject(void* object, size_t slotCount);
+
+        /// <summary>
+        /// Destructor for the shadow virtual table (the object's own table is restored)
+        /// </summary>
+        ~ShadowVTable();
+
+        /// <summary>
+        /// Replaces the address within a slot of the shadow table
+        /// </summary>
+        void SetSlot(size_t index, void* address);
+
+        /// <summary>
+        /// Gets the address within a slot of the object's own table
+        /// </summary>
+        void* GetOriginal(size_t index) const;
+
+        /// <summary>
+        /// Gets the number of slots within the table
+        /// </summary>
+        size_t GetSlotCount() const;
+
+    private:
+        /// <summary>
+        /// Constructs a shadow virtual table and installs it
+        /// </summary>
+        ShadowVTable(void* object, size_t slotCount);
+
+        // Private members
+        std::unique_ptr<void*[]> mSlots;
+        void** mOriginal;
+        void** mTable;
+        void* mObject;
+        size_t mSlotCount;
+    };
+}
@@ -2,6 +2,7 @@
 #include <string>
 
 #include "Function.hpp"
+#include "Detour.hpp"
 
 namespace gm {
     class StaticFunction : public Function {
@@ -27,21 +28,7 @@ namespace gm {
         /// </summary>
         virtual void SetDetour(bool enabled);
 
-        /// <summary>
-        /// Applies the hook
-        /// </summary>
-        void ApplyHook();
-
-        /// <summary>
-        /// Removes the hook
-        /// </summary>
-        void RemoveHook();
-
         // Private members
-        std::shared_ptr<byte> mTrampoline;
-        size_t mBytesDisassembled;
-
-        // Static members
-        static const byte PatchRelative[];
+        std::unique_ptr<Detour> mDetour;
     };
 }
@@ -2,7 +2,7 @@
 
 namespace gm {
     /// <summary>
-    /// Gets the offset of any method within a class virtual table (max 10 virtual methods)
+    /// Gets the offset of any method within a class virtual table (max 32 virtual methods)
     /// </summary>
     template <class T, typename F>
     size_t VTableOffset(F function) {
@@ -17,6 +17,28 @@ namespace gm {
             virtual size_t Get8()  { return 7; }
             virtual size_t Get9()  { return 8; }
             virtual size_t Get10() { return 9; }
+            virtual size_t Get11() { return 10; }
+            virtual size_t Get12() { return 11; }
+            virtual size_t Get13() { return 12; }
+            virtual size_t Get14() { return 13; }
+            virtual size_t Get15() { return 14; }
+            virtual size_t Get16() { return 15; }
+            virtual size_t Get17() { return 16; }
+            virtual size_t Get18() { return 17; }
+            virtual size_t Get19() { return 18; }
+            virtual size_t Get20() { return 19; }
+            virtual size_t Get21() { return 20; }
+            virtual size_t Get22() { return 21; }
+            virtual size_t Get23() { return 22; }
+            virtual size_t Get24() { return 23; }
+            virtual size_t Get25() { return 24; }
+            virtual size_t Get26() { return 25; }
+            virtual size_t Get27() { return 26; }
+            virtual size_t Get28() { return 27; }
+            virtual size_t Get29() { return 28; }
+            virtual size_t Get30() { return 29; }
+            virtual size_t Get31() { return 30; }
+            virtual size_t Get32() { return 31; }
         } vt;
 
         T* object = reinterpret_cast<T*>(&vt);
@@ -0,0 +1,60 @@
+#include <atomic>
+#include <cassert>
+
+#include "VirtualFunction.hpp"
+#include "../OS/MemoryRegion.hpp"
+
+namespace gm {
+    VirtualFunction::VirtualFunction(std::string name, ConventionInfo cInfo, void** vtable, size_t index) :
+        Function(name, cInfo),
+        mSlot(nullptr)
+    {
+        if(vtable == nullptr) {
+            throw Exception("the virtual table is invalid");
+        }
+
+        mSlot = &vtable[index];
+        mOriginal = *mSlot;
+
+        if(mOriginal == nullptr) {
+            throw Exception("the virtual table slot is empty");
+        }
+
+        // Keep the generated code close to the function, so it shares pages with the rest of its module
+        mCodeGenerator->SetLocality(mOriginal);
+    }
+
+    void* VirtualFunction::GetCallableAddress() {
+        // The function itself is never modified, so there is no need for a trampoline
+        return mOriginal;
+    }
+
+    void VirtualFunction::SetDetour(bool enabled) {
+        if(mDetoured == enabled) {
+            return;
+        }
+
+        if(enabled == true) {
+            // The callable address doesn't depend on the detour, so the flag is only set once the slot is written
+            this->WriteSlot(this->GetHookAddress());
+            mDetoured = true;
+        } else /* Remove hook */ {
+            this->WriteSlot(mOriginal);
+            mDetoured = false;
+        }
+    }
+
+    void VirtualFunction::WriteSlot(void* address) {
+        try {
+            // Virtual tables are usually read-only, and may share their page with code that other threads are
+            // executing, so the page keeps its flags and is only made writable for a moment
+            MemoryRegion region(reinterpret_cast<uintptr_t>(mSlot), sizeof(void*));
+            region.AddFlags(MemoryRegion::Write);
+
+            // The slot is aligned, so other threads either see the old or the new address
+            reinterpret_cast<std::atomic<void*>*>(mSlot)->store(address);
+        } catch(const MemoryRegion::Exception& ex) {
+            throw Exception(ex.what());
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+#include "Function.hpp"
+
+namespace gm {
+    class VirtualFunction : public Function {
+    public:
+        /// <summary>
+        /// The exception that this class throws
+        /// </summary>
+        GM_DEFINE_EXCEPTION_INHERIT(Exception, Function::Exception);
+
+        /// <summary>
+        /// Constructs a virtual function instance from a slot within a virtual table
+        /// </summary>
+        VirtualFunction(std::string name, ConventionInfo cInfo, void** vtable, size_t index);
+
+        /// <summary>
+        /// Gets a callable address to the function
+        /// </summary>
+        virtual void* GetCallableAddress();
+
+    private:
+        /// <summary>
+        /// Applies (or removes) the function detour (i.e hook)
+        /// </summary>
+        virtual void SetDetour(bool enabled);
+
+        /// <summary>
+        /// Replaces the address within the virtual table slot
+        /// </summary>
+        void WriteSlot(void* address);
+
+        // Private members
+        void** mSlot;
+    };
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <GoldMeta/Gold/IModuleFunction.hpp>
 #include <GoldMeta/Shared.hpp>
+#include <mutex>
 
 namespace gm {
     // Forward declarations
@@ -11,7 +13,7 @@ namespace gm {
     class IFunctionBase {
     public:
         /// <summary>
-        /// Gets a plugin specific function module
+        /// Creates a new function module (i.e listener) for a plugin
         /// </summary>
         virtual IModuleFunction* GetModule(PluginId plugin) = 0;
 
@@ -23,7 +25,22 @@ namespace gm {
         /// <summary>
         /// Removes a loaded function module
         /// </summary>
-        virtual void RemoveModule(PluginId plugin) = 0;
+        virtual void RemoveModule(IModuleFunction* module) = 0;
+
+        /// <summary>
+        /// Removes all function modules that belong to a plugin
+        /// </summary>
+        virtual void RemoveModules(PluginId plugin) = 0;
+
+        /// <summary>
+        /// Notifies the function that one of its modules has been modified
+        /// </summary>
+        virtual void UpdateModules() = 0;
+
+        /// <summary>
+        /// Gets the lock that modules hold while they are modified and published (so an update never reads a half-modified module)
+        /// </summary>
+        virtual std::recursive_mutex& GetUpdateMutex() = 0;
 
         /// <summary>
         /// Calls the target function in a generic way
@@ -40,6 +57,11 @@ namespace gm {
         /// </summary>
         virtual void InvalidESP() = 0;
 
+        /// <summary>
+        /// This method gets called before a handler is entered, and returns the address to jump to
+        /// </summary>
+        virtual void* OnDispatch() = 0;
+
         /// <summary>
         /// This method gets called when the assembly code is entered
         /// </summary>
@@ -59,5 +81,31 @@ namespace gm {
         /// Iterates to the next module and returns it
         /// </summary>
         virtual void ResetIterator() = 0;
+
+        /// <summary>
+        /// Memoizes the results of the function, returning whether it can be memoized
+        /// </summary>
+        virtual bool SetCacheScope(Cache::Scope scope) = 0;
+
+        /// <summary>
+        /// Removes all memoized results
+        /// </summary>
+        virtual void InvalidateCache() = 0;
+
+        /// <summary>
+        /// This method gets called by memoizing handlers after they are entered, and returns whether the
+        /// result was cached (it is then stored as the override return, and the call is superseded)
+        /// </summary>
+        virtual bool OnCacheLookup() = 0;
+
+        /// <summary>
+        /// This method gets called by memoizing handlers before they exit, to store the result
+        /// </summary>
+        virtual void OnCacheStore() = 0;
+
+        /// <summary>
+        /// This method gets called by capturing handlers before they exit, to queue the call for asynchronous listeners
+        /// </summary>
+        virtual void OnAsyncCapture() = 0;
     };
 }
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cassert>
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/mman.h>
+#endif
+
+#include "CodeArena.hpp"
+
+namespace /* Anonymous */ {
+    uintptr_t Distance(uintptr_t a, uintptr_t b) {
+        return (a > b) ? (a - b) : (b - a);
+    }
+}
+
+namespace gm {
+    CodeArena& CodeArena::GetGlobal() {
+        // Generated code may still be executed while static objects are destroyed, so this is never freed
+        static CodeArena* arena = new CodeArena();
+        return *arena;
+    }
+
+    void* CodeArena::Allocate(size_t size, const void* locality) {
+        assert(size > 0);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        uintptr_t target = reinterpret_cast<uintptr_t>(locality);
+
+        size = (size + Alignment - 1) & ~(Alignment - 1);
+
+        // Prefer the closest region, so code for the same function (and module) is packed together
+        std::vector<Region*> candidates;
+
+        for(auto& region : mRegions) {
+            if(locality == nullptr || Distance(region->base, target) <= MaxLocalityDistance) {
+                candidates.push_back(region.get());
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [target](Region* a, Region* b) {
+            return Distance(a->base, target) < Distance(b->base, target);
+        });
+
+        for(Region* region : candidates) {
+            if(void* memory = AllocateFrom(*region, size)) {
+                return memory;
+            }
+        }
+
+        void* memory = AllocateFrom(this->ReserveRegion(size, target), size);
+        assert(memory != nullptr);
+
+        return memory;
+    }
+
+    void CodeArena::Release(void* memory) {
+        if(memory == nullptr) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+
+        for(auto& region : mRegions) {
+            if(address < region->base || address >= region->base + region->size) {
+                continue;
+            }
+
+            size_t offset = address - region->base;
+            auto it = region->allocated.find(offset);
+            assert(it != region->allocated.end());
+
+            size_t size = it->second;
+            region->allocated.erase(it);
+            region->used -= size;
+
+            // Merge the block with any adjacent free blocks
+            auto next = region->free.lower_bound(offset);
+
+            if(next != region->free.end() && offset + size == next->first) {
+                size += next->second;
+                next = region->free.erase(next);
+            }
+
+            if(next != region->free.begin()) {
+                auto previous = std::prev(next);
+
+                if(previous->first + previous->second == offset) {
+                    previous->second += size;
+                    return;
+                }
+            }
+
+            region->free.emplace(offset, size);
+            return;
+        }
+
+        assert(false && "the memory does not belong to the arena");
+    }
+
+    CodeArena::Usage CodeArena::GetUsage() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Usage usage = {};
+
+        for(auto& region : mRegions) {
+            usage.reserved += region->size;
+            usage.used += region->used;
+        }
+
+        usage.regions = mRegions.size();
+        return usage;
+    }
+
+    void* CodeArena::AllocateFrom(Region& region, size_t size) {
+        // First fit, since most allocations are small and made at once for each function
+        for(auto it = region.free.begin(); it != region.free.end(); ++it) {
+            if(it->second < size) {
+                continue;
+            }
+
+            size_t offset = it->first;
+            size_t remaining = it->second - size;
+
+            region.free.erase(it);
+
+            if(remaining > 0) {
+                region.free.emplace(offset + size, remaining);
+            }
+
+            region.allocated.emplace(offset, size);
+            region.used += size;
+
+            return reinterpret_cast<void*>(region.base + offset);
+        }
+
+        return nullptr;
+    }
+
+    CodeArena::Region& CodeArena::ReserveRegion(size_t size, uintptr_t locality) {
+        size = (size + RegionSize - 1) & ~(RegionSize - 1);
+        void* memory = nullptr;
+
+        if(locality != 0) {
+            uintptr_t origin = locality & ~(RegionSize - 1);
+
+            // Search outwards from the locality, alternating between the space above and below it
+            for(size_t step = 1; memory == nullptr && step * RegionSize <= MaxLocalityDistance; step++) {
+                uintptr_t above = origin + step * RegionSize;
+                uintptr_t below = origin - step * RegionSize;
+
+                if(above > origin) {
+                    memory = ReserveMemory(above, size);
+                }
+
+                if(memory == nullptr && below < origin) {
+                    memory = ReserveMemory(below, size);
+                }
+            }
+        }
+
+        if(memory == nullptr) {
+            // On x86 any address is within reach of a 'jmp rel32', so this is still usable
+            memory = ReserveMemory(0, size);
+        }
+
+        if(memory == nullptr) {
+            throw Exception("couldn't reserve executable memory");
+        }
+
+        std::unique_ptr<Region> region(new Region());
+        region->base = reinterpret_cast<uintptr_t>(memory);
+        region->size = size;
+        region->used = 0;
+        region->free.emplace(0, size);
+
+        mRegions.push_back(std::move(region));
+        return *mRegions.back();
+    }
+
+    void* CodeArena::ReserveMemory(uintptr_t address, size_t size) {
+#ifdef _WIN32
+        // This fails if any part of the range is in use, so it never returns memory elsewhere
+        return VirtualAlloc(reinterpret_cast<void*>(address), size, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+#else
+        // The address is only a hint, so the result is discarded unless it was honoured
+        void* memory = mmap(reinterpret_cast<void*>(address), size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if(memory == MAP_FAILED) {
+            return nullptr;
+        } else if(address != 0 && reinterpret_cast<uintptr_t>(memory) != address) {
+            munmap(memory, size);
+            return nullptr;
+        }
+
+        return memory;
+#endif
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../Default.hpp"
+#include "../Exception.hpp"
+
+namespace gm {
+    /// <summary>
+    /// Executable memory for generated code, placed as close as possible to the code it hooks
+    /// </summary>
+    class CodeArena {
+    public:
+        /// <summary>
+        /// The exception class that the code arena throws
+        /// </summary>
+        GM_DEFINE_EXCEPTION(Exception);
+
+        /// <summary>
+        /// The size of each region reserved from the system (the allocation granularity on Windows)
+        /// </summary>
+        static const size_t RegionSize = 64 * 1024;
+
+        /// <summary>
+        /// The alignment of each allocation (so code starts on a fetch boundary)
+        /// </summary>
+        static const size_t Alignment = 16;
+
+        /// <summary>
+        /// The maximum distance between an allocation and its locality before a new region is reserved
+        /// </summary>
+        static const size_t MaxLocalityDistance = 16 * 1024 * 1024;
+
+        /// <summary>
+        /// Describes the memory used by the arena
+        /// </summary>
+        struct Usage {
+            size_t reserved; /* The number of bytes reserved from the system */
+            size_t used;     /* The number of bytes currently allocated */
+            size_t regions;  /* The number of regions reserved */
+        };
+
+        /// <summary>
+        /// Gets the arena used for all generated code
+        /// </summary>
+        static CodeArena& GetGlobal();
+
+        /// <summary>
+        /// Allocates executable memory, preferably near a locality (e.g the hooked function)
+        /// </summary>
+        void* Allocate(size_t size, const void* locality = nullptr);
+
+        /// <summary>
+        /// Releases memory previously allocated by this arena
+        /// </summary>
+        void Release(void* memory);
+
+        /// <summary>
+        /// Gets the current memory usage of the arena
+        /// </summary>
+        Usage GetUsage() const;
+
+    private:
+        /// <summary>
+        /// Describes a block of memory reserved from the system
+        /// </summary>
+        struct Region {
+            uintptr_t base;
+            size_t size;
+            size_t used;
+            std::map<size_t, size_t> free;      /* Free blocks by offset */
+            std::map<size_t, size_t> allocated; /* Allocated blocks by offset */
+        };
+
+        /// <summary>
+        /// Allocates a block from a region, if it has enough contiguous space
+        /// </summary>
+        static void* AllocateFrom(Region& region, size_t size);
+
+        /// <summary>
+        /// Reserves a new region, preferably within the locality distance
+        /// </summary>
+        Region& ReserveRegion(size_t size, uintptr_t locality);
+
+        /// <summary>
+        /// Reserves executable memory from the system at (or near) an address
+        /// </summary>
+        static void* ReserveMemory(uintptr_t address, size_t size);
+
+        // Private members
+        std::vector<std::unique_ptr<Region>> mRegions;
+        mutable std::mutex mMutex;
+    };
+}
@@ -0,0 +1,273 @@
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#ifdef _WIN32
+# include <windows.h>
+# include <TlHelp32.h>
+#elif __linux__
+# include <cerrno>
+# include <cstdlib>
+# include <dirent.h>
+# include <signal.h>
+# include <ucontext.h>
+# include <unistd.h>
+# include <sys/syscall.h>
+#endif
+
+#include "HotPatch.hpp"
+#include "MemoryRegion.hpp"
+
+namespace /* Anonymous */ {
+    // Only one patch may be in progress, since the stages of two overlapping ones would interleave
+    std::mutex gPatchMutex;
+
+    // Unaligned stores are only atomic as long as they do not cross a cache line
+    const uintptr_t CacheLineSize = 64;
+
+#ifdef __linux__
+    // The instruction reported by the last thread that was inspected, and its ID (stored last)
+    std::atomic<uintptr_t> gReportedInstruction(0);
+    std::atomic<pid_t> gReportedThread(0);
+
+    /// <summary>
+    /// Reports where the interrupted thread was executing (this runs in a signal handler)
+    /// </summary>
+    void OnInspectThread(int, siginfo_t*, void* context) {
+        int error = errno;
+        const ucontext_t* ucontext = static_cast<const ucontext_t*>(context);
+
+# ifdef __x86_64__
+        gReportedInstruction.store(static_cast<uintptr_t>(ucontext->uc_mcontext.gregs[REG_RIP]));
+# else
+        gReportedInstruction.store(static_cast<uintptr_t>(ucontext->uc_mcontext.gregs[REG_EIP]));
+# endif
+        gReportedThread.store(static_cast<pid_t>(syscall(SYS_gettid)));
+        errno = error;
+    }
+
+    /// <summary>
+    /// Gets the signal used to inspect threads, installing its handler the first time
+    /// </summary>
+    int GetInspectionSignal() {
+        static std::once_flag installed;
+        static bool available = false;
+
+        std::call_once(installed, [] {
+            struct sigaction action = {};
+            action.sa_sigaction = &OnInspectThread;
+            action.sa_flags = SA_SIGINFO | SA_RESTART;
+            sigemptyset(&action.sa_mask);
+
+            // The handler is never removed, since a thread may only respond once it has been given up on
+            available = (sigaction(SIGRTMIN, &action, nullptr) == 0);
+        });
+
+        return available ? SIGRTMIN : -1;
+    }
+#endif
+}
+
+namespace gm {
+    // 'jmp <self>' - Parks any thread entering the code until the patch is complete
+    const byte HotPatch::SpinJump[] = { 0xEB, 0xFE };
+
+    void HotPatch::Write(void* target, const void* data, size_t size) {
+        assert(target != nullptr);
+        assert(data != nullptr);
+        assert(size > 0);
+
+        std::lock_guard<std::mutex> lock(gPatchMutex);
+
+        byte* code = static_cast<byte*>(target);
+        const byte* bytes = static_cast<const byte*>(data);
+
+        MemoryRegion region(reinterpret_cast<uintptr_t>(code), size);
+        region.SetFlags(MemoryRegion::Execute | MemoryRegion::Read | MemoryRegion::Write);
+
+        // The simple case, the whole patch fits within one aligned quadword
+        if(!HotPatch::StoreAtomic(code, bytes, size)) {
+#if !defined(_WIN32) && !defined(__linux__)
+            // Other threads' registers cannot be inspected here, so there is no way of knowing
+            // whether one is still within the code that the second stage would overwrite
+            throw Exception("the code cannot be patched atomically, since it crosses a quadword boundary");
+#else
+            byte previous[GM_ARRAY_SIZE(SpinJump)];
+            std::memcpy(previous, code, sizeof(previous));
+
+            if(size < GM_ARRAY_SIZE(SpinJump) || !HotPatch::StoreAtomic(code, SpinJump, GM_ARRAY_SIZE(SpinJump))) {
+                throw Exception("the code cannot be patched atomically");
+            }
+
+            try {
+                // Threads arriving from now on spin at the start, but some may already be past it
+                HotPatch::WaitForQuiescence(reinterpret_cast<uintptr_t>(code) + 1, reinterpret_cast<uintptr_t>(code) + size);
+            } catch(const Exception&) {
+                // Let the parked threads continue with the untouched code
+                HotPatch::StoreAtomic(code, previous, sizeof(previous));
+                throw;
+            }
+            std::memcpy(code + GM_ARRAY_SIZE(SpinJump), bytes + GM_ARRAY_SIZE(SpinJump), size - GM_ARRAY_SIZE(SpinJump));
+
+            // The spinning threads continue with the new code once the first instruction is replaced
+            bool result = HotPatch::StoreAtomic(code, bytes, GM_ARRAY_SIZE(SpinJump));
+            assert(result == true);
+#endif
+        }
+
+#ifdef _WIN32
+        FlushInstructionCache(GetCurrentProcess(), code, size);
+#else
+        __builtin___clear_cache(reinterpret_cast<char*>(code), reinterpret_cast<char*>(code + size));
+#endif
+    }
+
+    bool HotPatch::StoreAtomic(byte* address, const byte* data, size_t size) {
+        uintptr_t block = reinterpret_cast<uintptr_t>(address) & ~static_cast<uintptr_t>(sizeof(uint64) - 1);
+        size_t offset = reinterpret_cast<uintptr_t>(address) - block;
+
+        if(offset + size <= sizeof(uint64)) {
+            // Merge the bytes with their surroundings, which may be modified by another patch
+            auto quadword = reinterpret_cast<std::atomic<uint64>*>(block);
+            uint64 expected = quadword->load();
+            uint64 desired;
+
+            do {
+                desired = expected;
+                std::memcpy(reinterpret_cast<byte*>(&desired) + offset, data, size);
+            } while(!quadword->compare_exchange_weak(expected, desired));
+
+            return true;
+        }
+
+        if(size == sizeof(ushort) && (reinterpret_cast<uintptr_t>(address) % CacheLineSize) != CacheLineSize - 1) {
+            ushort value;
+            std::memcpy(&value, data, sizeof(ushort));
+
+            // Unaligned word stores within a cache line are atomic on x86
+            *reinterpret_cast<volatile ushort*>(address) = value;
+            return true;
+        }
+
+        return false;
+    }
+
+#if defined(_WIN32) || defined(__linux__)
+    void HotPatch::WaitForQuiescence(uintptr_t begin, uintptr_t end) {
+# ifdef _WIN32
+        for(uint attempt = 0; attempt < QuiescenceAttempts; attempt++) {
+            HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+
+            if(snapshot == INVALID_HANDLE_VALUE) {
+                throw Exception("couldn't create thread snapshot");
+            }
+
+            THREADENTRY32 entry = {0};
+            entry.dwSize = sizeof(THREADENTRY32);
+            bool quiescent = true;
+
+            for(BOOL result = Thread32First(snapshot, &entry); result && quiescent; result = Thread32Next(snapshot, &entry)) {
+                if(entry.th32OwnerProcessID != GetCurrentProcessId() || entry.th32ThreadID == GetCurrentThreadId()) {
+                    continue;
+                }
+
+                HANDLE thread = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT, FALSE, entry.th32ThreadID);
+
+                if(thread == nullptr) {
+                    continue;
+                }
+
+                // The context is only reliable while the thread is suspended
+                if(SuspendThread(thread) != static_cast<DWORD>(-1)) {
+                    CONTEXT context = {0};
+                    context.ContextFlags = CONTEXT_CONTROL;
+
+                    if(GetThreadContext(thread, &context)) {
+# ifdef _M_X64
+                        uintptr_t instruction = context.Rip;
+# else
+                        uintptr_t instruction = context.Eip;
+# endif
+                        quiescent = (instruction < begin || instruction >= end);
+                    }
+
+                    ResumeThread(thread);
+                }
+
+                CloseHandle(thread);
+            }
+
+            CloseHandle(snapshot);
+
+            if(quiescent) {
+                return;
+            }
+
+            Sleep(1);
+        }
+# else
+        int signal = GetInspectionSignal();
+
+        if(signal == -1) {
+            throw Exception("couldn't install the thread inspection handler");
+        }
+
+        pid_t process = getpid();
+        pid_t self = static_cast<pid_t>(syscall(SYS_gettid));
+
+        for(uint attempt = 0; attempt < QuiescenceAttempts; attempt++) {
+            DIR* tasks = opendir("/proc/self/task");
+
+            if(tasks == nullptr) {
+                throw Exception("couldn't enumerate the process' threads");
+            }
+
+            bool quiescent = true;
+
+            for(dirent* entry = readdir(tasks); entry != nullptr && quiescent; entry = readdir(tasks)) {
+                pid_t thread = static_cast<pid_t>(std::atoi(entry->d_name));
+
+                if(thread <= 0 || thread == self) {
+                    continue;
+                }
+
+                gReportedThread.store(0);
+
+                // Like a suspended thread, a thread within a signal handler reports the instruction it was interrupted at
+                if(syscall(SYS_tgkill, process, thread, signal) != 0) {
+                    // The thread has exited since the directory was read
+                    continue;
+                }
+
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ResponseTimeout);
+
+                while(gReportedThread.load() != thread) {
+                    if(std::chrono::steady_clock::now() >= deadline) {
+                        // The thread blocks the signal, so there is no telling where it is
+                        closedir(tasks);
+                        throw Exception(format("thread %d could not be inspected") % thread);
+                    }
+
+                    std::this_thread::yield();
+                }
+
+                uintptr_t instruction = gReportedInstruction.load();
+                quiescent = (instruction < begin || instruction >= end);
+            }
+
+            closedir(tasks);
+
+            if(quiescent) {
+                return;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+# endif
+
+        throw Exception("a thread did not leave the patched code");
+    }
+#endif
+}
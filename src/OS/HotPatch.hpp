@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../Default.hpp"
+#include "../Exception.hpp"
+
+namespace gm {
+    /// <summary>
+    /// Modifies code that other threads may be executing at the same time
+    /// </summary>
+    class HotPatch {
+    public:
+        /// <summary>
+        /// The exception class that the hot patcher throws
+        /// </summary>
+        GM_DEFINE_EXCEPTION(Exception);
+
+        /// <summary>
+        /// The number of attempts made to find a moment when no thread executes the patched code
+        /// </summary>
+        static const uint QuiescenceAttempts = 1000;
+
+        /// <summary>
+        /// How long a thread is given to report where it is executing, once it has been signaled (Linux only, in milliseconds)
+        /// </summary>
+        static const uint ResponseTimeout = 100;
+
+        /// <summary>
+        /// Overwrites code, so that a concurrently executing thread either sees the old or the new instructions.
+        /// A patch that does not fit within an aligned quadword is written in two stages, which is only possible
+        /// where other threads can be inspected (Windows and Linux); elsewhere an exception is thrown instead.
+        /// </summary>
+        static void Write(void* target, const void* data, size_t size);
+
+    private:
+        /// <summary>
+        /// Writes bytes with a single store, returning false if their location does not allow it
+        /// </summary>
+        static bool StoreAtomic(byte* address, const byte* data, size_t size);
+
+        /// <summary>
+        /// Waits until no other thread executes an instruction within a range (Windows and Linux only)
+        /// </summary>
+        static void WaitForQuiescence(uintptr_t begin, uintptr_t end);
+
+        // Static members
+        static const byte SpinJump[];
+    };
+}
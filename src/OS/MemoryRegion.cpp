@@ -1,80 +1,136 @@
-#include <map>
-#include <regex>
+#include <cassert>
 #include <string>
 #include <fstream>
+#include <sstream>
 #ifdef _WIN32
 # include <windows.h>
 #else
 # include <sys/mman.h>
+# include <unistd.h>
 #endif
 
 #include "MemoryRegion.hpp"
 #include "OS.hpp"
 
+namespace /* Anonymous */ {
+#ifdef _WIN32
+    DWORD ToNativeFlags(ulong flags) {
+        bool execute = (flags & gm::MemoryRegion::Execute) != 0;
+
+        if(flags & gm::MemoryRegion::Write) {
+            return execute ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE;
+        } else if(flags & gm::MemoryRegion::Read) {
+            return execute ? PAGE_EXECUTE_READ : PAGE_READONLY;
+        } else {
+            return execute ? PAGE_EXECUTE : PAGE_NOACCESS;
+        }
+    }
+
+    ulong FromNativeFlags(DWORD protection) {
+        switch(protection & 0xFF) {
+            case PAGE_EXECUTE:           return gm::MemoryRegion::Execute;
+            case PAGE_EXECUTE_READ:      return gm::MemoryRegion::Execute | gm::MemoryRegion::Read;
+            case PAGE_EXECUTE_READWRITE:
+            case PAGE_EXECUTE_WRITECOPY: return gm::MemoryRegion::Execute | gm::MemoryRegion::Read | gm::MemoryRegion::Write;
+            case PAGE_READONLY:          return gm::MemoryRegion::Read;
+            case PAGE_READWRITE:
+            case PAGE_WRITECOPY:         return gm::MemoryRegion::Read | gm::MemoryRegion::Write;
+            default:                     return 0;
+        }
+    }
+#else
+    int ToNativeFlags(ulong flags) {
+        int protection = PROT_NONE;
+
+        if(flags & gm::MemoryRegion::Execute) { protection |= PROT_EXEC; }
+        if(flags & gm::MemoryRegion::Write)   { protection |= PROT_WRITE; }
+        if(flags & gm::MemoryRegion::Read)    { protection |= PROT_READ; }
+
+        return protection;
+    }
+#endif
+}
+
 namespace gm {
     MemoryRegion::MemoryRegion(uintptr_t address, size_t size) :
+        mPageSize(0),
         mAddress(address),
         mSize(size),
-        mPageSize(0),
         mReset(true)
     {
         assert(address > 0);
         assert(size > 0);
 
 #ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        mPageSize = info.dwPageSize;
 #else
-        if((mPageSize = sysconf(_SC_PAGE_SIZE)) == -1) {
+        long pageSize = sysconf(_SC_PAGE_SIZE);
+
+        if(pageSize == -1) {
             throw Exception("couldn't retrieve system page size");
         }
 
+        mPageSize = static_cast<size_t>(pageSize);
+#endif
+
         uintptr_t startPage = (address & ~(mPageSize - 1));
-        uintptr_t lastPage = ((address + size) & ~(mPageSize - 1));
+        uintptr_t lastPage = ((address + size - 1) & ~(mPageSize - 1));
 
-        uint pageCount = (lastPage - startPage / mPageSize) + 1;
+        uint pageCount = ((lastPage - startPage) / mPageSize) + 1;
         mPages.reserve(pageCount);
 
-        std::ifstream fmaps("/proc/self/maps");
-        std::regex regex("^([0-9a-fA-F]+)-[0-9a-fA-F]+ (\\w|-){4}");
-        std::string input;
-
         for(uint i = 0; i < pageCount; i++) {
             Page page = {};
 
             page.size = mPageSize;
             page.base = startPage + (mPageSize * i);
+            mPages.push_back(page);
+        }
 
-            while(std::getline(fmaps, input)) {
-                // Create our regex iterator so we can check each of our group
-                std::sregex_token_iterator it(input.begin(), input.end(), regex, 1);
+#ifdef _WIN32
+        for(Page& page : mPages) {
+            MEMORY_BASIC_INFORMATION information;
 
-                // The addresses are in hex, and therefore we must add '0x'
-                // otherwise 'stoul' won't recognize the string as hex
-                if(std::stoul(str(format("0x%s") % *it), 0, 16) != page.base) {
-                    continue;
-                }
+            if(!VirtualQuery(reinterpret_cast<void*>(page.base), &information, sizeof(MEMORY_BASIC_INFORMATION))) {
+                throw Exception("couldn't query memory region flags");
+            }
 
-                std::string permissions = *(++it);
+            page.initialFlags = FromNativeFlags(information.Protect);
+        }
+#else
+        std::ifstream fmaps("/proc/self/maps");
+        std::string input;
 
-                static const std::map<char, ulong> Keys = {
-                    { 'r', Read },
-                    { 'w', Write },
-                    { 'x', Execute },
-                };
+        while(std::getline(fmaps, input)) {
+            // Each line begins with '<start>-<end> <rwxp>', with both addresses in hex
+            std::istringstream line(input);
+            uintptr_t start, end;
+            std::string permissions;
+            char separator;
 
-                int index = 0;
+            if(!(line >> std::hex >> start >> separator >> end >> permissions) || permissions.size() < 3) {
+                continue;
+            }
 
-                for(auto& pair : Keys) {
-                    if(permissions[index++] == pair.first) {
-                        page.initialFlags |= pair.second;
-                    }
+            for(Page& page : mPages) {
+                if(page.base < start || page.base >= end) {
+                    continue;
                 }
+
+                page.initialFlags = 0;
+                if(permissions[0] == 'r') { page.initialFlags |= Read; }
+                if(permissions[1] == 'w') { page.initialFlags |= Write; }
+                if(permissions[2] == 'x') { page.initialFlags |= Execute; }
             }
+        }
+#endif
 
+        for(Page& page : mPages) {
             // We haven't changed any flags yet
             page.currentFlags = page.initialFlags;
-            mPages.push_back(page);
         }
-#endif
     }
 
     MemoryRegion::~MemoryRegion() {
@@ -83,11 +139,15 @@ namespace gm {
         }
 
         for(Page& page : mPages) {
+            if(page.currentFlags == page.initialFlags) {
+                continue;
+            }
+
 #ifdef _WIN32
-            static ulong dummy;
-            VirtualProtect(page.base, page.size, page.initialFlags, dummy);
+            DWORD dummy;
+            VirtualProtect(reinterpret_cast<void*>(page.base), page.size, ToNativeFlags(page.initialFlags), &dummy);
 #else
-            mprotect(reinterpret_cast<void*>(page.base), page.size, page.initialFlags);
+            mprotect(reinterpret_cast<void*>(page.base), page.size, ToNativeFlags(page.initialFlags));
 #endif
         }
     }
@@ -95,12 +155,12 @@ namespace gm {
     void MemoryRegion::SetFlags(ulong flags) {
         for(Page& page : mPages) {
 #ifdef _WIN32
-            static ulong dummy;
-            if(!VirtualProtect(page.base, page.size, flags, dummy)) {
+            DWORD dummy;
+            if(!VirtualProtect(reinterpret_cast<void*>(page.base), page.size, ToNativeFlags(flags), &dummy)) {
                 throw Exception("couldn't update memory region flags");
             }
 #else
-            if(!mprotect(reinterpret_cast<void*>(page.base), page.size, page.initialFlags)) {
+            if(mprotect(reinterpret_cast<void*>(page.base), page.size, ToNativeFlags(flags)) != 0) {
                 throw Exception("couldn't update memory region flags");
             }
 #endif
@@ -108,6 +168,24 @@ namespace gm {
         }
     }
 
+    void MemoryRegion::AddFlags(ulong flags) {
+        for(Page& page : mPages) {
+            ulong pageFlags = page.initialFlags | flags;
+
+#ifdef _WIN32
+            DWORD dummy;
+            if(!VirtualProtect(reinterpret_cast<void*>(page.base), page.size, ToNativeFlags(pageFlags), &dummy)) {
+                throw Exception("couldn't update memory region flags");
+            }
+#else
+            if(mprotect(reinterpret_cast<void*>(page.base), page.size, ToNativeFlags(pageFlags)) != 0) {
+                throw Exception("couldn't update memory region flags");
+            }
+#endif
+            page.currentFlags = pageFlags;
+        }
+    }
+
     uint MemoryRegion::GetPageCount() const {
         return mPages.size();
     }
@@ -17,9 +17,9 @@ namespace gm {
         /// Describes the different memory flags
         /// </summary>
         enum Flags : ulong {
-            Execute = (1 >> 0),
-            Write   = (1 >> 1),
-            Read    = (1 >> 2)
+            Execute = (1 << 0),
+            Write   = (1 << 1),
+            Read    = (1 << 2)
         };
 
         /// <summary>
@@ -37,6 +37,11 @@ namespace gm {
         /// </summary>
         void SetFlags(ulong flags);
 
+        /// <summary>
+        /// Adds protection flags to each page within the region, keeping the ones it already has
+        /// </summary>
+        void AddFlags(ulong flags);
+
         /// <summary>
         /// Gets the number of pages within the region
         /// </summary>
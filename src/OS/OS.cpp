@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #ifdef _WIN32
@@ -84,6 +85,176 @@ namespace gm {
         return modules;
     }
 
+#ifndef _WIN32
+    namespace /* Anonymous */ {
+        struct ImportSearch {
+            const std::string* module;
+            const std::string* symbol;
+            Import result;
+        };
+
+        template <typename Relocation>
+        void** FindRelocation(ElfW(Addr) base, const Relocation* table, size_t size, const ElfW(Sym)* symbols, const char* strings, const std::string& symbol) {
+            for(size_t i = 0; i < size / sizeof(Relocation); i++) {
+                const Relocation& relocation = table[i];
+# ifdef __x86_64__
+                uint32_t type = ELF64_R_TYPE(relocation.r_info);
+                uint32_t index = ELF64_R_SYM(relocation.r_info);
+                bool isImport = (type == R_X86_64_JUMP_SLOT || type == R_X86_64_GLOB_DAT);
+# else
+                uint32_t type = ELF32_R_TYPE(relocation.r_info);
+                uint32_t index = ELF32_R_SYM(relocation.r_info);
+                bool isImport = (type == R_386_JMP_SLOT || type == R_386_GLOB_DAT);
+# endif
+                if(isImport && index != 0 && symbol == &strings[symbols[index].st_name]) {
+                    return reinterpret_cast<void**>(base + relocation.r_offset);
+                }
+            }
+
+            return nullptr;
+        }
+    }
+#endif
+
+    Import FindImport(const std::string& module, const std::string& symbol) {
+        Import result = { nullptr, nullptr };
+
+#ifdef _WIN32
+        BYTE* base = reinterpret_cast<BYTE*>(GetModuleHandleA(module.empty() ? nullptr : module.c_str()));
+
+        if(base == nullptr) {
+            throw Exception("couldn't find the module");
+        }
+
+        auto dosHeader = reinterpret_cast<IMAGE_DOS_HEADER*>(base);
+        auto ntHeader = reinterpret_cast<IMAGE_NT_HEADERS*>(base + dosHeader->e_lfanew);
+        const IMAGE_DATA_DIRECTORY& directory = ntHeader->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+
+        if(directory.VirtualAddress == 0) {
+            throw Exception("the module has no imports");
+        }
+
+        for(auto descriptor = reinterpret_cast<IMAGE_IMPORT_DESCRIPTOR*>(base + directory.VirtualAddress); descriptor->Name != 0 && result.slot == nullptr; descriptor++) {
+            // Bound modules may lack the name table, in which case the address table still contains the names
+            auto names = reinterpret_cast<IMAGE_THUNK_DATA*>(base + (descriptor->OriginalFirstThunk ? descriptor->OriginalFirstThunk : descriptor->FirstThunk));
+            auto slots = reinterpret_cast<IMAGE_THUNK_DATA*>(base + descriptor->FirstThunk);
+
+            for(size_t i = 0; names[i].u1.AddressOfData != 0; i++) {
+                if(IMAGE_SNAP_BY_ORDINAL(names[i].u1.Ordinal)) {
+                    continue;
+                }
+
+                auto byName = reinterpret_cast<IMAGE_IMPORT_BY_NAME*>(base + names[i].u1.AddressOfData);
+
+                if(symbol == reinterpret_cast<const char*>(byName->Name)) {
+                    result.slot = reinterpret_cast<void**>(&slots[i].u1.Function);
+                    result.address = *result.slot;
+                    break;
+                }
+            }
+        }
+#else
+        ImportSearch search = { &module, &symbol, result };
+
+        dl_iterate_phdr([](struct dl_phdr_info* info, size_t /*size*/, void* data) {
+            ImportSearch& search = *reinterpret_cast<ImportSearch*>(data);
+
+            if(fs::path(info->dlpi_name).filename().string() != *search.module) {
+                return 0;
+            }
+
+            const ElfW(Dyn)* dynamic = nullptr;
+            size_t moduleSize = 0;
+
+            for(int i = 0; i < info->dlpi_phnum; i++) {
+                if(info->dlpi_phdr[i].p_type == PT_DYNAMIC) {
+                    dynamic = reinterpret_cast<const ElfW(Dyn)*>(info->dlpi_addr + info->dlpi_phdr[i].p_vaddr);
+                }
+
+                if(info->dlpi_phdr[i].p_type == PT_LOAD) {
+                    moduleSize = std::max<size_t>(moduleSize, info->dlpi_phdr[i].p_vaddr + info->dlpi_phdr[i].p_memsz);
+                }
+            }
+
+            if(dynamic == nullptr) {
+                return 1;
+            }
+
+            ElfW(Addr) base = info->dlpi_addr;
+            ElfW(Addr) symbols = 0, strings = 0, pltTable = 0, pltSize = 0, pltType = DT_REL;
+            ElfW(Addr) relTable = 0, relSize = 0, relaTable = 0, relaSize = 0;
+
+            for(const ElfW(Dyn)* entry = dynamic; entry->d_tag != DT_NULL; entry++) {
+                // The loader usually relocates these, but not for every module (e.g the vDSO)
+                ElfW(Addr) pointer = entry->d_un.d_ptr < base ? base + entry->d_un.d_ptr : entry->d_un.d_ptr;
+
+                switch(entry->d_tag) {
+                    case DT_SYMTAB:   symbols = pointer; break;
+                    case DT_STRTAB:   strings = pointer; break;
+                    case DT_JMPREL:   pltTable = pointer; break;
+                    case DT_PLTRELSZ: pltSize = entry->d_un.d_val; break;
+                    case DT_PLTREL:   pltType = entry->d_un.d_val; break;
+                    case DT_REL:      relTable = pointer; break;
+                    case DT_RELSZ:    relSize = entry->d_un.d_val; break;
+                    case DT_RELA:     relaTable = pointer; break;
+                    case DT_RELASZ:   relaSize = entry->d_un.d_val; break;
+                }
+            }
+
+            if(symbols == 0 || strings == 0) {
+                return 1;
+            }
+
+            auto symbolTable = reinterpret_cast<const ElfW(Sym)*>(symbols);
+            auto stringTable = reinterpret_cast<const char*>(strings);
+            void** slot = nullptr;
+
+            // Calls use the PLT relocations, while taking the address of a function uses the regular ones
+            if(pltTable != 0) {
+                slot = (pltType == DT_RELA)
+                    ? FindRelocation(base, reinterpret_cast<const ElfW(Rela)*>(pltTable), pltSize, symbolTable, stringTable, *search.symbol)
+                    : FindRelocation(base, reinterpret_cast<const ElfW(Rel)*>(pltTable), pltSize, symbolTable, stringTable, *search.symbol);
+            }
+
+            if(slot == nullptr && relTable != 0) {
+                slot = FindRelocation(base, reinterpret_cast<const ElfW(Rel)*>(relTable), relSize, symbolTable, stringTable, *search.symbol);
+            }
+
+            if(slot == nullptr && relaTable != 0) {
+                slot = FindRelocation(base, reinterpret_cast<const ElfW(Rela)*>(relaTable), relaSize, symbolTable, stringTable, *search.symbol);
+            }
+
+            if(slot != nullptr) {
+                search.result.slot = slot;
+                search.result.address = *slot;
+
+                // With lazy binding the slot still points into the module's own PLT, so resolve the symbol instead
+                uintptr_t address = reinterpret_cast<uintptr_t>(*slot);
+
+                if(address >= base && address < base + moduleSize) {
+                    void* process = dlopen(nullptr, RTLD_NOW);
+                    search.result.address = dlsym(process, search.symbol->c_str());
+                    dlclose(process);
+                }
+            }
+
+            return 1;
+        }, &search);
+
+        result = search.result;
+#endif
+
+        if(result.slot == nullptr) {
+            throw Exception("couldn't find the imported symbol");
+        }
+
+        if(result.address == nullptr) {
+            throw Exception("couldn't resolve the imported symbol");
+        }
+
+        return result;
+    }
+
     fs::path GetModulePath(void* memory) {
 #ifdef _WIN32
         MEMORY_BASIC_INFORMATION information;
@@ -59,6 +59,20 @@ namespace gm {
     /// </summary>
     std::vector<Module> GetProcessModules();
 
+    /// <summary>
+    /// Describes an imported function of a module
+    /// </summary>
+    struct Import {
+        void** slot;
+        void* address;
+    };
+
+    /// <summary>
+    /// Finds the import table slot (GOT or IAT entry) that a module uses to call a symbol
+    /// from another library; an empty module name refers to the main executable
+    /// </summary>
+    Import FindImport(const std::string& module, const std::string& symbol);
+
     /// <summary>
     /// Gets the library path of a module that is identified by a memory address
     /// </summary>